@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Monotonic memory for short-lived containers: allocation bumps a pointer, deallocation does nothing,
+// all memory is given back at once by release() or by destruction of the arena.
+// Arena must outlive every container that uses it.
+
+class Arena {
+public:
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit Arena(size_t chunk_size = kDefaultChunkSize);
+  // first allocations use buffer, it is not freed by arena
+  Arena(void* buffer, size_t size, size_t chunk_size = kDefaultChunkSize);
+
+  Arena(const Arena& other) = delete;
+  Arena& operator=(const Arena& other) = delete;
+
+  void* allocate(size_t size, size_t align);
+  void release();
+
+  ~Arena();
+private:
+  struct Chunk {
+    Chunk* next;
+  };
+
+  void AddChunk(size_t min_size);
+
+  char* initial_buffer_;
+  size_t initial_size_;
+  char* cur_;
+  char* end_;
+  Chunk* chunks_ = nullptr;
+  size_t chunk_size_;
+};
+
+inline Arena::Arena(size_t chunk_size):
+  initial_buffer_(nullptr),
+  initial_size_(0),
+  cur_(nullptr),
+  end_(nullptr),
+  chunk_size_(chunk_size)
+{}
+
+inline Arena::Arena(void* buffer, size_t size, size_t chunk_size):
+  initial_buffer_(static_cast<char*>(buffer)),
+  initial_size_(size),
+  cur_(initial_buffer_),
+  end_(initial_buffer_ + size),
+  chunk_size_(chunk_size)
+{}
+
+inline void Arena::AddChunk(size_t min_size) {
+  size_t chunk_size = std::max(chunk_size_, min_size + sizeof(Chunk) + alignof(std::max_align_t));
+  char* memory = static_cast<char*>(::operator new(chunk_size));
+  Chunk* chunk = reinterpret_cast<Chunk*>(memory);
+  chunk->next = chunks_;
+  chunks_ = chunk;
+
+  cur_ = memory + sizeof(Chunk);
+  end_ = memory + chunk_size;
+}
+
+inline void* Arena::allocate(size_t size, size_t align) {
+  uintptr_t aligned = (reinterpret_cast<uintptr_t>(cur_) + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+  if (cur_ == nullptr || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+    AddChunk(size + align);
+    aligned = (reinterpret_cast<uintptr_t>(cur_) + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+  }
+  cur_ = reinterpret_cast<char*>(aligned + size);
+  return reinterpret_cast<void*>(aligned);
+}
+
+inline void Arena::release() {
+  while (chunks_ != nullptr) {
+    Chunk* next = chunks_->next;
+    ::operator delete(static_cast<void*>(chunks_));
+    chunks_ = next;
+  }
+  cur_ = initial_buffer_;
+  end_ = initial_buffer_ == nullptr ? nullptr : initial_buffer_ + initial_size_;
+}
+
+inline Arena::~Arena() {
+  release();
+}
+
+template<typename T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+  // lets List skip per-node deallocation walk
+  using is_deallocate_noop = std::true_type;
+
+  // no default constructor: allocator without arena has nowhere to put memory,
+  // so containers that default construct their allocator do not compile with it
+  ArenaAllocator(Arena& arena) noexcept: arena_(&arena) {}
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept: arena_(other.arena_) {}
+
+  T* allocate(size_t n);
+  void deallocate(T*, size_t) noexcept {}
+
+  Arena* arena() const { return arena_; }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena_; }
+  template<typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena_; }
+private:
+  Arena* arena_;
+
+  template<typename U>
+  friend class ArenaAllocator;
+};
+
+template<typename T>
+T* ArenaAllocator<T>::allocate(size_t n) {
+  return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Objects whose last owner died are queued here instead of being destroyed inline,
+// destructors run in drain(): either at quiescent points chosen by user or in background thread after start().
+// Use with smart pointers through DeferredDeleter: SharedPtr<T>(ptr, DeferredDeleter<T>(reclaimer)).
+
+struct ReclaimStats {
+  size_t queue_depth = 0;
+  size_t max_queue_depth = 0;
+  uint64_t reclaimed = 0;
+  // time from retire() to destruction
+  std::chrono::nanoseconds max_latency{0};
+  std::chrono::nanoseconds total_latency{0};
+};
+
+class DeferredReclaimer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  DeferredReclaimer() = default;
+  DeferredReclaimer(const DeferredReclaimer& other) = delete;
+  DeferredReclaimer& operator=(const DeferredReclaimer& other) = delete;
+
+  template<typename T>
+  void retire(T* ptr);
+
+  // destroys everything retired before the call, returns number of destroyed objects
+  size_t drain();
+
+  // background thread drains queue every interval or when it is stopped
+  void start(std::chrono::milliseconds interval = std::chrono::milliseconds(1));
+  void stop();
+
+  ReclaimStats stats() const;
+
+  ~DeferredReclaimer();
+private:
+  struct Retired {
+    void* ptr;
+    void (*destroy)(void*);
+    Clock::time_point retire_time;
+  };
+
+  void RetireRaw(void* ptr, void (*destroy)(void*));
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<Retired> pending_;
+  ReclaimStats stats_;
+
+  std::thread worker_;
+  bool stop_requested_ = false;
+};
+
+template<typename T>
+void DeferredReclaimer::retire(T* ptr) {
+  RetireRaw(ptr, [](void* obj) { delete static_cast<T*>(obj); });
+}
+
+inline void DeferredReclaimer::RetireRaw(void* ptr, void (*destroy)(void*)) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.push_back({ptr, destroy, Clock::now()});
+  stats_.queue_depth = pending_.size();
+  if (stats_.queue_depth > stats_.max_queue_depth) {
+    stats_.max_queue_depth = stats_.queue_depth;
+  }
+}
+
+inline size_t DeferredReclaimer::drain() {
+  std::vector<Retired> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch.swap(pending_);
+    stats_.queue_depth = 0;
+  }
+  // destructors may retire more objects, so they run without lock
+  std::chrono::nanoseconds max_latency{0};
+  std::chrono::nanoseconds total_latency{0};
+  for (Retired& retired : batch) {
+    retired.destroy(retired.ptr);
+    std::chrono::nanoseconds latency = Clock::now() - retired.retire_time;
+    total_latency += latency;
+    if (latency > max_latency) {
+      max_latency = latency;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.reclaimed += batch.size();
+  stats_.total_latency += total_latency;
+  if (max_latency > stats_.max_latency) {
+    stats_.max_latency = max_latency;
+  }
+  return batch.size();
+}
+
+inline void DeferredReclaimer::start(std::chrono::milliseconds interval) {
+  if (worker_.joinable()) {
+    return;
+  }
+  stop_requested_ = false;
+  worker_ = std::thread([this, interval]() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_requested_) {
+      wake_.wait_for(lock, interval, [this]() { return stop_requested_; });
+      lock.unlock();
+      drain();
+      lock.lock();
+    }
+  });
+}
+
+inline void DeferredReclaimer::stop() {
+  if (!worker_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+}
+
+inline ReclaimStats DeferredReclaimer::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+inline DeferredReclaimer::~DeferredReclaimer() {
+  stop();
+  // objects retired by destructors during drain are drained too
+  while (drain() != 0) {}
+}
+
+template<typename T>
+class DeferredDeleter {
+public:
+  explicit DeferredDeleter(DeferredReclaimer& reclaimer): reclaimer_(&reclaimer) {}
+
+  void operator()(T* ptr) const {
+    if (ptr) {
+      reclaimer_->retire(ptr);
+    }
+  }
+private:
+  DeferredReclaimer* reclaimer_;
+};
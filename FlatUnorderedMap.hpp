@@ -0,0 +1,783 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Open addressing map in Swiss table style: keys and values live inline in one slot array,
+// every slot has one control byte which is empty, deleted or 7 low bits of the hash (H2).
+// Probing goes over groups of 16 control bytes which are matched by one SSE2 compare.
+
+namespace flat_map_detail {
+  using ctrl_t = int8_t;
+  constexpr ctrl_t kEmpty = -128;
+  constexpr ctrl_t kDeleted = -2;
+  constexpr ctrl_t kSentinel = -1;
+
+  inline bool IsFull(ctrl_t ctrl) { return ctrl >= 0; }
+
+  // bit i of every mask <-> i-th control byte of the group
+  struct Group {
+    static constexpr uint32_t kWidth = 16;
+#if defined(__SSE2__)
+    __m128i ctrl;
+
+    explicit Group(const ctrl_t* pos): ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+    uint32_t Match(ctrl_t h2) const {
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+    }
+    uint32_t MatchEmpty() const { return Match(kEmpty); }
+    uint32_t MatchEmptyOrDeleted() const {
+      // empty and deleted are the only values less than sentinel
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(kSentinel), ctrl)));
+    }
+#else
+    ctrl_t ctrl[kWidth];
+
+    explicit Group(const ctrl_t* pos) { std::memcpy(ctrl, pos, kWidth); }
+
+    uint32_t Match(ctrl_t h2) const {
+      uint32_t res = 0;
+      for (uint32_t i = 0; i < kWidth; ++i) {
+        res |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+      }
+      return res;
+    }
+    uint32_t MatchEmpty() const { return Match(kEmpty); }
+    uint32_t MatchEmptyOrDeleted() const {
+      uint32_t res = 0;
+      for (uint32_t i = 0; i < kWidth; ++i) {
+        res |= static_cast<uint32_t>(ctrl[i] < kSentinel) << i;
+      }
+      return res;
+    }
+#endif
+  };
+
+  // control bytes of map without allocation: only sentinel, so begin() == end()
+  inline ctrl_t* EmptyCtrl() {
+    alignas(16) static ctrl_t empty_group[Group::kWidth] = {
+      kSentinel, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty,
+      kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty
+    };
+    return empty_group;
+  }
+
+  // std::hash of integers is identity, so spread entropy over all bits before splitting to H1 and H2
+  inline uint64_t Mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  inline uint64_t H1(uint64_t hash) { return hash >> 7; }
+  inline ctrl_t H2(uint64_t hash) { return static_cast<ctrl_t>(hash & 0x7F); }
+};
+
+template<typename Key, typename Val, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, Val>>>
+class FlatUnorderedMap {
+public:
+  using PairType = std::pair<const Key, Val>;
+private:
+  using ctrl_t = flat_map_detail::ctrl_t;
+  using Group = flat_map_detail::Group;
+  using AllocTraits = std::allocator_traits<Alloc>;
+  using CtrlAlloc = typename AllocTraits::template rebind_alloc<ctrl_t>;
+  using CtrlAllocTraits = std::allocator_traits<CtrlAlloc>;
+
+  ctrl_t* ctrl_;
+  PairType* slots_;
+  uint32_t capacity_;
+  uint32_t element_cnt_;
+  // how many empty slots can be filled before rehash, deleted slots are not counted
+  uint32_t growth_left_;
+  double max_load_factor_ = 0.875;
+
+  [[no_unique_address]] Alloc alloc_;
+  [[no_unique_address]] Hash hasher_;
+  [[no_unique_address]] Equal key_equal_;
+
+  template<bool is_const>
+  class Iterator {
+  private:
+    using SlotPtr = std::conditional_t<is_const, const PairType*, PairType*>;
+    const ctrl_t* ctrl_;
+    SlotPtr slot_;
+
+    void SkipEmpty() {
+      while (*ctrl_ < flat_map_detail::kSentinel) {
+        ++ctrl_;
+        ++slot_;
+      }
+    }
+  public:
+    using value_type = std::conditional_t<is_const, const PairType, PairType>;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+
+    using reference = std::conditional_t<is_const, const PairType&, PairType&>;
+    using pointer = std::conditional_t<is_const, const PairType*, PairType*>;
+
+    Iterator(): ctrl_(nullptr), slot_(nullptr) {}
+    Iterator(const Iterator& other) = default;
+    Iterator(const Iterator<false>& other) requires(is_const) : ctrl_(other.ctrl_), slot_(other.slot_) {}
+    Iterator(const ctrl_t* ctrl, SlotPtr slot): ctrl_(ctrl), slot_(slot) {}
+
+    Iterator& operator=(const Iterator& other) = default;
+
+    Iterator& operator++() { ++ctrl_; ++slot_; SkipEmpty(); return *this; }
+    Iterator operator++(int) { Iterator cur = *this; ++*this; return cur; }
+
+    template<bool other_const>
+    bool operator==(const Iterator<other_const>& other) const { return ctrl_ == other.ctrl_; }
+    template<bool other_const>
+    bool operator!=(const Iterator<other_const>& other) const { return ctrl_ != other.ctrl_; }
+
+    reference operator*() const { return *slot_; }
+    pointer operator->() const { return slot_; }
+
+    ~Iterator() = default;
+
+    friend class FlatUnorderedMap;
+    template<bool>
+    friend class Iterator;
+  };
+
+  uint64_t HashOf(const Key& key) const { return flat_map_detail::Mix(hasher_(key)); }
+  uint32_t GrowthCapacity(uint32_t capacity) const;
+
+  uint32_t FindIndex(const Key& key, uint64_t hash) const;
+  uint32_t FindInsertIndex(uint64_t hash) const;
+  void SetCtrl(uint32_t idx, ctrl_t ctrl) { ctrl_[idx] = ctrl; }
+
+  template<typename... Args>
+  uint32_t EmplaceAt(uint64_t hash, Args&&... args);
+
+  template<typename K>
+  Val& GetOrAdd(K&& key);
+
+  void Rehash(uint32_t new_capacity);
+  void CheckRehash();
+  void DestroyAll();
+  void ResetToEmpty();
+  void StealFrom(FlatUnorderedMap& other);
+  // other must have same hash function, map must be empty
+  void CopySlotsFrom(const FlatUnorderedMap& other);
+
+public:
+  FlatUnorderedMap();
+  FlatUnorderedMap(const Alloc& alloc);
+
+  FlatUnorderedMap(const FlatUnorderedMap& other);
+  FlatUnorderedMap(FlatUnorderedMap&& other) noexcept;
+
+  FlatUnorderedMap& operator=(const FlatUnorderedMap& other);
+  FlatUnorderedMap& operator=(FlatUnorderedMap&& other);
+
+  Val& operator[](const Key& key);
+  Val& operator[](Key&& key);
+
+  Val& at(const Key& key);
+  const Val& at(const Key& key) const;
+
+  uint32_t size() const;
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_iterator cbegin() const;
+  const_iterator cend() const;
+
+  std::pair<iterator, bool> insert(const PairType& cur);
+  std::pair<iterator, bool> insert(PairType&& cur);
+  template<typename InputIt>
+  void insert(InputIt start, InputIt end);
+
+  void erase(iterator cur);
+  template<typename InputIt>
+  void erase(InputIt start, InputIt end);
+
+  void reserve(uint32_t sz);
+
+  double load_factor() const;
+  double max_load_factor() const;
+  void max_load_factor(double f);
+
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args);
+
+  const_iterator find(const Key& key) const;
+  iterator find(const Key& key);
+  void swap(FlatUnorderedMap& other);
+
+  ~FlatUnorderedMap();
+private:
+  template<typename F>
+  std::pair<iterator, bool> insert_helper(F&& cur);
+  static constexpr uint32_t initial_size_ = flat_map_detail::Group::kWidth;
+};
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::FlatUnorderedMap():
+  ctrl_(flat_map_detail::EmptyCtrl()),
+  slots_(nullptr),
+  capacity_(0),
+  element_cnt_(0),
+  growth_left_(0)
+{}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::FlatUnorderedMap(const Alloc& alloc):
+  ctrl_(flat_map_detail::EmptyCtrl()),
+  slots_(nullptr),
+  capacity_(0),
+  element_cnt_(0),
+  growth_left_(0),
+  alloc_(alloc)
+{}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::FlatUnorderedMap(const FlatUnorderedMap& other):
+  ctrl_(flat_map_detail::EmptyCtrl()),
+  slots_(nullptr),
+  capacity_(0),
+  element_cnt_(0),
+  growth_left_(0),
+  max_load_factor_(other.max_load_factor_),
+  alloc_(AllocTraits::select_on_container_copy_construction(other.alloc_)),
+  hasher_(other.hasher_),
+  key_equal_(other.key_equal_) {
+  CopySlotsFrom(other);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::CopySlotsFrom(const FlatUnorderedMap& other) {
+  if (other.capacity_ == 0) {
+    return;
+  }
+  CtrlAlloc ctrl_alloc(alloc_);
+  ctrl_t* new_ctrl = CtrlAllocTraits::allocate(ctrl_alloc, other.capacity_ + 1);
+  PairType* new_slots;
+  try {
+    new_slots = AllocTraits::allocate(alloc_, other.capacity_);
+  } catch (...) {
+    CtrlAllocTraits::deallocate(ctrl_alloc, new_ctrl, other.capacity_ + 1);
+    throw;
+  }
+  // same capacity and same hash function -> every element keeps its position
+  std::memcpy(new_ctrl, other.ctrl_, other.capacity_ + 1);
+  uint32_t idx = 0;
+  try {
+    for (; idx < other.capacity_; ++idx) {
+      if (flat_map_detail::IsFull(other.ctrl_[idx])) {
+        AllocTraits::construct(alloc_, new_slots + idx, other.slots_[idx]);
+      }
+    }
+  } catch (...) {
+    for (uint32_t i = 0; i < idx; ++i) {
+      if (flat_map_detail::IsFull(new_ctrl[i])) {
+        AllocTraits::destroy(alloc_, new_slots + i);
+      }
+    }
+    AllocTraits::deallocate(alloc_, new_slots, other.capacity_);
+    CtrlAllocTraits::deallocate(ctrl_alloc, new_ctrl, other.capacity_ + 1);
+    throw;
+  }
+  ctrl_ = new_ctrl;
+  slots_ = new_slots;
+  capacity_ = other.capacity_;
+  element_cnt_ = other.element_cnt_;
+  growth_left_ = other.growth_left_;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::FlatUnorderedMap(FlatUnorderedMap&& other) noexcept:
+  ctrl_(other.ctrl_),
+  slots_(other.slots_),
+  capacity_(other.capacity_),
+  element_cnt_(other.element_cnt_),
+  growth_left_(other.growth_left_),
+  max_load_factor_(other.max_load_factor_),
+  alloc_(std::move(other.alloc_)),
+  hasher_(std::move(other.hasher_)),
+  key_equal_(std::move(other.key_equal_)) {
+  other.ResetToEmpty();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>& FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::operator=(const FlatUnorderedMap& other) {
+  if (this == &other) {
+    return *this;
+  }
+  constexpr bool propagate = AllocTraits::propagate_on_container_copy_assignment::value;
+  // copy is allocated by the allocator we will have after assignment
+  FlatUnorderedMap tmp(propagate ? other.alloc_ : alloc_);
+  tmp.max_load_factor_ = other.max_load_factor_;
+  tmp.hasher_ = other.hasher_;
+  tmp.key_equal_ = other.key_equal_;
+  tmp.CopySlotsFrom(other);
+  DestroyAll();
+  if constexpr (propagate) {
+    alloc_ = tmp.alloc_;
+  }
+  StealFrom(tmp);
+  return *this;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>& FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::operator=(FlatUnorderedMap&& other) {
+  if (this == &other) {
+    return *this;
+  }
+  constexpr bool propagate = AllocTraits::propagate_on_container_move_assignment::value;
+  constexpr bool always_equal = AllocTraits::is_always_equal::value;
+  if (propagate || always_equal || alloc_ == other.alloc_) {
+    DestroyAll();
+    StealFrom(other);
+    return *this;
+  }
+
+  // memory of other can not be released by our allocator -> move elements one by one
+  DestroyAll();
+  hasher_ = other.hasher_;
+  key_equal_ = other.key_equal_;
+  max_load_factor_ = other.max_load_factor_;
+  reserve(other.element_cnt_);
+  for (iterator it = other.begin(); it != other.end(); ++it) {
+    EmplaceAt(HashOf(it->first), std::move(const_cast<Key&>(it->first)), std::move(it->second));
+  }
+  other.DestroyAll();
+  return *this;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::~FlatUnorderedMap() {
+  DestroyAll();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::ResetToEmpty() {
+  ctrl_ = flat_map_detail::EmptyCtrl();
+  slots_ = nullptr;
+  capacity_ = 0;
+  element_cnt_ = 0;
+  growth_left_ = 0;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::DestroyAll() {
+  if (capacity_ == 0) {
+    return;
+  }
+  if constexpr (!std::is_trivially_destructible_v<PairType>) {
+    for (uint32_t i = 0; i < capacity_; ++i) {
+      if (flat_map_detail::IsFull(ctrl_[i])) {
+        AllocTraits::destroy(alloc_, slots_ + i);
+      }
+    }
+  }
+  CtrlAlloc ctrl_alloc(alloc_);
+  AllocTraits::deallocate(alloc_, slots_, capacity_);
+  CtrlAllocTraits::deallocate(ctrl_alloc, ctrl_, capacity_ + 1);
+  ResetToEmpty();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::StealFrom(FlatUnorderedMap& other) {
+  ctrl_ = other.ctrl_;
+  slots_ = other.slots_;
+  capacity_ = other.capacity_;
+  element_cnt_ = other.element_cnt_;
+  growth_left_ = other.growth_left_;
+  max_load_factor_ = other.max_load_factor_;
+  if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+    alloc_ = std::move(other.alloc_);
+  }
+  hasher_ = std::move(other.hasher_);
+  key_equal_ = std::move(other.key_equal_);
+  other.ResetToEmpty();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::swap(FlatUnorderedMap& other) {
+  if (this == &other) return;
+  constexpr bool propagate = AllocTraits::propagate_on_container_swap::value;
+  constexpr bool always_equal = AllocTraits::is_always_equal::value;
+  if (propagate || always_equal || alloc_ == other.alloc_) {
+    std::swap(ctrl_, other.ctrl_);
+    std::swap(slots_, other.slots_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(element_cnt_, other.element_cnt_);
+    std::swap(growth_left_, other.growth_left_);
+    std::swap(max_load_factor_, other.max_load_factor_);
+    std::swap(hasher_, other.hasher_);
+    std::swap(key_equal_, other.key_equal_);
+    if constexpr (propagate) {
+      std::swap(alloc_, other.alloc_);
+    }
+    return;
+  }
+
+  FlatUnorderedMap tmp = std::move(*this);
+  *this = std::move(other);
+  other = std::move(tmp);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+uint32_t FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::GrowthCapacity(uint32_t capacity) const {
+  // at least one empty slot must stay, otherwise probing of missing key never stops
+  // and at least one slot can be filled, otherwise insert after rehash has no room
+  uint32_t growth = static_cast<double>(capacity) * max_load_factor_;
+  return std::max<uint32_t>(std::min(growth, capacity - 1), 1);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+uint32_t FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::FindIndex(const Key& key, uint64_t hash) const {
+  if (capacity_ == 0) {
+    return capacity_;
+  }
+  const uint32_t group_mask = capacity_ / Group::kWidth - 1;
+  const ctrl_t h2 = flat_map_detail::H2(hash);
+  uint32_t group_idx = flat_map_detail::H1(hash) & group_mask;
+  // triangular probing over power of two groups visits every group exactly once
+  for (uint32_t step = 1; step <= group_mask + 1; ++step) {
+    Group group(ctrl_ + group_idx * Group::kWidth);
+    for (uint32_t match = group.Match(h2); match != 0; match &= match - 1) {
+      uint32_t idx = group_idx * Group::kWidth + std::countr_zero(match);
+      if (key_equal_(slots_[idx].first, key)) {
+        return idx;
+      }
+    }
+    if (group.MatchEmpty() != 0) {
+      return capacity_;
+    }
+    group_idx = (group_idx + step) & group_mask;
+  }
+  return capacity_;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+uint32_t FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::FindInsertIndex(uint64_t hash) const {
+  const uint32_t group_mask = capacity_ / Group::kWidth - 1;
+  uint32_t group_idx = flat_map_detail::H1(hash) & group_mask;
+  for (uint32_t step = 1;; ++step) {
+    Group group(ctrl_ + group_idx * Group::kWidth);
+    uint32_t match = group.MatchEmptyOrDeleted();
+    if (match != 0) {
+      return group_idx * Group::kWidth + std::countr_zero(match);
+    }
+    group_idx = (group_idx + step) & group_mask;
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename... Args>
+uint32_t FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::EmplaceAt(uint64_t hash, Args&&... args) {
+  CheckRehash();
+  uint32_t idx = FindInsertIndex(hash);
+  AllocTraits::construct(alloc_, slots_ + idx, std::forward<Args>(args)...);
+  if (ctrl_[idx] == flat_map_detail::kEmpty) {
+    --growth_left_;
+  }
+  SetCtrl(idx, flat_map_detail::H2(hash));
+  ++element_cnt_;
+  return idx;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::CheckRehash() {
+  if (growth_left_ > 0) {
+    return;
+  }
+  if (capacity_ == 0) {
+    Rehash(initial_size_);
+  } else if (element_cnt_ < GrowthCapacity(capacity_) / 2) {
+    // most of used slots are deleted -> clean them without growing
+    Rehash(capacity_);
+  } else {
+    // with small load factor doubling once may not be enough
+    uint32_t new_capacity = capacity_ * 2;
+    while (GrowthCapacity(new_capacity) <= element_cnt_) {
+      if (new_capacity > UINT32_MAX / 2) {
+        throw std::length_error("FlatUnorderedMap is too big");
+      }
+      new_capacity *= 2;
+    }
+    Rehash(new_capacity);
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::Rehash(uint32_t new_capacity) {
+  CtrlAlloc ctrl_alloc(alloc_);
+  ctrl_t* new_ctrl = CtrlAllocTraits::allocate(ctrl_alloc, new_capacity + 1);
+  PairType* new_slots;
+  try {
+    new_slots = AllocTraits::allocate(alloc_, new_capacity);
+  } catch (...) {
+    CtrlAllocTraits::deallocate(ctrl_alloc, new_ctrl, new_capacity + 1);
+    throw;
+  }
+  std::memset(new_ctrl, static_cast<unsigned char>(flat_map_detail::kEmpty), new_capacity);
+  new_ctrl[new_capacity] = flat_map_detail::kSentinel;
+
+  ctrl_t* old_ctrl = ctrl_;
+  PairType* old_slots = slots_;
+  uint32_t old_capacity = capacity_;
+  ctrl_ = new_ctrl;
+  slots_ = new_slots;
+  capacity_ = new_capacity;
+
+  constexpr bool can_move = std::is_nothrow_move_constructible_v<Key> && std::is_nothrow_move_constructible_v<Val>;
+  uint32_t idx = 0;
+  try {
+    for (; idx < old_capacity; ++idx) {
+      if (!flat_map_detail::IsFull(old_ctrl[idx])) {
+        continue;
+      }
+      uint64_t hash = HashOf(old_slots[idx].first);
+      uint32_t new_idx = FindInsertIndex(hash);
+      if constexpr (can_move) {
+        AllocTraits::construct(alloc_, new_slots + new_idx, std::move(const_cast<Key&>(old_slots[idx].first)), std::move(old_slots[idx].second));
+      } else {
+        AllocTraits::construct(alloc_, new_slots + new_idx, old_slots[idx]);
+      }
+      SetCtrl(new_idx, flat_map_detail::H2(hash));
+    }
+  } catch (...) {
+    // old table is untouched because only copies were made
+    for (uint32_t i = 0; i < new_capacity; ++i) {
+      if (flat_map_detail::IsFull(new_ctrl[i])) {
+        AllocTraits::destroy(alloc_, new_slots + i);
+      }
+    }
+    AllocTraits::deallocate(alloc_, new_slots, new_capacity);
+    CtrlAllocTraits::deallocate(ctrl_alloc, new_ctrl, new_capacity + 1);
+    ctrl_ = old_ctrl;
+    slots_ = old_slots;
+    capacity_ = old_capacity;
+    throw;
+  }
+
+  if (old_capacity > 0) {
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+      if (flat_map_detail::IsFull(old_ctrl[i])) {
+        AllocTraits::destroy(alloc_, old_slots + i);
+      }
+    }
+    AllocTraits::deallocate(alloc_, old_slots, old_capacity);
+    CtrlAllocTraits::deallocate(ctrl_alloc, old_ctrl, old_capacity + 1);
+  }
+  growth_left_ = GrowthCapacity(capacity_) - element_cnt_;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::reserve(uint32_t sz) {
+  uint32_t need_size = initial_size_;
+  while (GrowthCapacity(need_size) < sz) {
+    if (need_size > UINT32_MAX / 2) {
+      throw std::length_error("FlatUnorderedMap is too big");
+    }
+    need_size *= 2;
+  }
+  if (need_size > capacity_) {
+    Rehash(need_size);
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::max_load_factor(double f) {
+  // with zero load factor nothing fits and table grows forever
+  if (!(f > 0)) {
+    throw std::invalid_argument("max_load_factor must be positive");
+  }
+  max_load_factor_ = f;
+  if (capacity_ > 0 && GrowthCapacity(capacity_) < element_cnt_) {
+    reserve(element_cnt_);
+  } else if (capacity_ > 0) {
+    growth_left_ = 0;
+    // recount deleted slots, they are still counted as used
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < capacity_; ++i) {
+      used += (ctrl_[i] != flat_map_detail::kEmpty);
+    }
+    uint32_t growth = GrowthCapacity(capacity_);
+    growth_left_ = (growth > used ? growth - used : 0);
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+double FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::max_load_factor() const {
+  return max_load_factor_;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+double FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::load_factor() const {
+  return (capacity_ == 0 ? 0.0 : static_cast<double>(element_cnt_) / capacity_);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+uint32_t FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::size() const {
+  return element_cnt_;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::find(const Key& key) const {
+  uint32_t idx = FindIndex(key, HashOf(key));
+  return const_iterator(ctrl_ + idx, slots_ + idx);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::find(const Key& key) {
+  uint32_t idx = FindIndex(key, HashOf(key));
+  return iterator(ctrl_ + idx, slots_ + idx);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename F>
+std::pair<typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::insert_helper(F&& cur) {
+  uint64_t hash = HashOf(cur.first);
+  uint32_t idx = FindIndex(cur.first, hash);
+  if (idx != capacity_) {
+    return {iterator(ctrl_ + idx, slots_ + idx), false};
+  }
+  idx = EmplaceAt(hash, std::forward<F>(cur));
+  return {iterator(ctrl_ + idx, slots_ + idx), true};
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+std::pair<typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::insert(const PairType& cur) {
+  return insert_helper(cur);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+std::pair<typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::insert(PairType&& cur) {
+  return insert_helper(std::move(cur));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename InputIt>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::insert(InputIt start, InputIt end) {
+  static_assert(std::is_same_v<PairType, typename InputIt::value_type>, "Iterator must point to NodeType");
+  for (InputIt cur = start; cur != end; ++cur) {
+    insert(*cur);
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename... Args>
+std::pair<typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::emplace(Args&&... args) {
+  PairType cur_node{std::forward<Args>(args)...};
+  return insert_helper(std::move(cur_node));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::erase(iterator cur) {
+  uint32_t idx = static_cast<uint32_t>(cur.ctrl_ - ctrl_);
+  AllocTraits::destroy(alloc_, slots_ + idx);
+  --element_cnt_;
+
+  // probe stops only at group with empty slot, so if group already has one nobody probes through it
+  Group group(ctrl_ + idx / Group::kWidth * Group::kWidth);
+  if (group.MatchEmpty() != 0) {
+    SetCtrl(idx, flat_map_detail::kEmpty);
+    ++growth_left_;
+  } else {
+    SetCtrl(idx, flat_map_detail::kDeleted);
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename InputIt>
+void FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::erase(InputIt start, InputIt end) {
+  static_assert(std::is_same_v<iterator, InputIt>, "Iterator must point to PairType");
+  for (InputIt cur = start; cur != end;) {
+    InputIt next = std::next(cur);
+    erase(cur);
+    cur = next;
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::begin() {
+  iterator it(ctrl_, slots_);
+  it.SkipEmpty();
+  return it;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::begin() const {
+  const_iterator it(ctrl_, slots_);
+  it.SkipEmpty();
+  return it;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::cbegin() const {
+  return begin();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::end() {
+  return iterator(ctrl_ + capacity_, slots_ + capacity_);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::end() const {
+  return const_iterator(ctrl_ + capacity_, slots_ + capacity_);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+typename FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::cend() const {
+  return end();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+Val& FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::at(const Key& key) {
+  iterator it = find(key);
+  if (it == end()) {
+    throw std::runtime_error("AT ERROR");
+  }
+  return it->second;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+const Val& FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::at(const Key& key) const {
+  const_iterator it = find(key);
+  if (it == end()) {
+    throw std::runtime_error("AT ERROR");
+  }
+  return it->second;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+Val& FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::operator[](const Key& key) {
+  return GetOrAdd(key);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+Val& FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::operator[](Key&& key) {
+  return GetOrAdd(std::move(key));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename K>
+Val& FlatUnorderedMap<Key, Val, Hash, Equal, Alloc>::GetOrAdd(K&& key) {
+  uint64_t hash = HashOf(key);
+  uint32_t idx = FindIndex(key, hash);
+  if (idx == capacity_) {
+    idx = EmplaceAt(hash, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple());
+  }
+  return slots_[idx].second;
+}
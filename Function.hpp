@@ -1,64 +1,81 @@
+#pragma once
+#include <cassert>
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <new>
 #include <optional>
+#include <type_traits>
 #include <typeinfo>
+#include <utility>
+
+// Builds without exceptions or RTTI are detected, both modes can also be forced by defining the macro.
+// FUNCTION_NO_EXCEPTIONS: calling empty function is contract violation, it asserts and aborts instead of throwing.
+// FUNCTION_NO_RTTI: target_type() is not available, target<T>() still works.
+#if !defined(FUNCTION_NO_EXCEPTIONS) && !defined(__cpp_exceptions)
+#define FUNCTION_NO_EXCEPTIONS
+#endif
+#if !defined(FUNCTION_NO_RTTI) && !defined(__cpp_rtti)
+#define FUNCTION_NO_RTTI
+#endif
 
 namespace function_detail {
-  template<bool IsMove, typename Ret, typename... Args>
-  struct ControlBlockMethodsPtrs {};
-
-  template<typename Ret, typename... Args>
-  struct ControlBlockMethodsPtrs<false, Ret, Args...> {
-    using copy_ptr_t = void*(*)(void*, void*);
-    using move_ptr_t = void*(*)(void*, void*);
-    using destroy_ptr_t = void(*)(void*, bool);
-    copy_ptr_t copy_ptr;
-    move_ptr_t move_ptr;
-    destroy_ptr_t destroy_ptr;
-    const std::type_info& type_info;
-
-    ControlBlockMethodsPtrs(): move_ptr(nullptr), destroy_ptr(nullptr) {};
-    ControlBlockMethodsPtrs(const copy_ptr_t& copy_ptr, const move_ptr_t& move_ptr,
-                            const destroy_ptr_t& destroy_ptr, const std::type_info& type_info):
-      copy_ptr(copy_ptr), move_ptr(move_ptr), destroy_ptr(destroy_ptr), type_info(type_info) {};
-
-    ControlBlockMethodsPtrs(const ControlBlockMethodsPtrs& other) = default;
-    ControlBlockMethodsPtrs(ControlBlockMethodsPtrs&& other) = default;
-    ControlBlockMethodsPtrs& operator=(const ControlBlockMethodsPtrs& other) = default;
-    ~ControlBlockMethodsPtrs() = default;
+  // address of per-type tag identifies stored type without typeid
+  template<typename T>
+  struct TypeTag {
+    static constexpr char kId = 0;
   };
+
+  template<typename T>
+  constexpr const void* TypeId() { return &TypeTag<T>::kId; }
+
+  // one static table per stored type, object itself is table pointer plus buffer
   template<typename Ret, typename... Args>
-  struct ControlBlockMethodsPtrs<true, Ret, Args...> {
-    using copy_ptr_t = void*(*)(void*, void*);
-    using move_ptr_t = void*(*)(void*, void*);
-    using destroy_ptr_t = void(*)(void*, bool);
-    move_ptr_t move_ptr;
-    destroy_ptr_t destroy_ptr;
-    const std::type_info& type_info;
-
-    ControlBlockMethodsPtrs(): move_ptr(nullptr), destroy_ptr(nullptr) {};
-    ControlBlockMethodsPtrs(std::nullptr_t, const move_ptr_t& move_ptr,
-                            const destroy_ptr_t& destroy_ptr, const std::type_info& type_info):
-      move_ptr(move_ptr), destroy_ptr(destroy_ptr), type_info(type_info) {};
-
-    ControlBlockMethodsPtrs(const ControlBlockMethodsPtrs& other) = default;
-    ControlBlockMethodsPtrs(ControlBlockMethodsPtrs&& other) = default;
-    ControlBlockMethodsPtrs& operator=(const ControlBlockMethodsPtrs& other) = default;
-    ~ControlBlockMethodsPtrs() = default;
+  struct VTable {
+    using invoke_ptr_t = Ret(*)(void*, Args...);
+    using copy_ptr_t = void(*)(const void*, void*);
+    using move_ptr_t = void(*)(void*, void*);
+    using destroy_ptr_t = void(*)(void*);
+
+    invoke_ptr_t invoke;
+    // nullptr means buffer can be copied or moved by memcpy
+    copy_ptr_t copy;
+    move_ptr_t move;
+    // nullptr means nothing to destroy
+    destroy_ptr_t destroy;
+    const void* type_id;
+#ifndef FUNCTION_NO_RTTI
+    const std::type_info* type_info;
+#endif
+    // callable lives in buffer, otherwise buffer holds pointer to heap copy
+    bool is_local;
   };
+
+  // trampoline shared by owning functions and FunctionRef, func points to F
+  // result of callable is dropped when signature returns void
+  template<typename F, typename Ret, typename... Args>
+  Ret Invoke(void* func, Args... args) {
+    if constexpr (std::is_void_v<Ret>) {
+      std::invoke(*static_cast<F*>(func), std::forward<Args>(args)...);
+    } else {
+      return std::invoke(*static_cast<F*>(func), std::forward<Args>(args)...);
+    }
+  }
 };
 
-template <bool IsMoveOnly, typename T>
+// BufferSize bytes are kept inline, bigger callables go to heap unless AllowHeap is false
+template <bool IsMoveOnly, typename T, size_t BufferSize = 16, bool AllowHeap = true>
 class FunctionBase {};
 
-template <bool IsMoveOnly, typename Ret, typename... Args>
-class FunctionBase<IsMoveOnly, Ret(Args...)> {
+template <bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+class FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap> {
 protected:
   template<typename T>
   struct is_FunctionBase : std::false_type {};
   template<typename T, typename... U>
-  struct is_FunctionBase<FunctionBase<IsMoveOnly, T(U...)>> : std::true_type {};
+  struct is_FunctionBase<FunctionBase<IsMoveOnly, T(U...), BufferSize, AllowHeap>> : std::true_type {};
 
   template<typename T>
   struct is_reference_wrapper : std::false_type {};
@@ -70,68 +87,73 @@ protected:
   template<typename T>
   constexpr static bool is_reference_wrapper_v = is_reference_wrapper<T>::value;
 protected:
-  using invoke_ptr_t = Ret(*)(void*, Args...);
+  using VTable = function_detail::VTable<Ret, Args...>;
+
+  static constexpr size_t BUFFER_SIZE = BufferSize;
+  static constexpr size_t BUFFER_ALIGN = alignof(void*);
+  static_assert(!AllowHeap || BUFFER_SIZE >= sizeof(void*), "buffer must be able to hold heap pointer");
+
+  template<typename F>
+  static constexpr bool FitsLocal() {
+    return sizeof(F) <= BUFFER_SIZE && alignof(F) <= BUFFER_ALIGN &&
+           std::is_nothrow_move_constructible_v<F>;
+  }
 
   static void SwapFuntions(FunctionBase& f, FunctionBase& s) {
-    std::swap(f.func_ptr_, s.func_ptr_);
-    std::swap(f.block_ptr_, s.block_ptr_);
-    std::swap(f.invoke_ptr_, s.invoke_ptr_);
-    std::swap(f.uses_local_storage_, s.uses_local_storage_);
+    // moved-from functions are empty, so they can be constructed over
+    FunctionBase tmp(std::move(f));
+    new (&f) FunctionBase(std::move(s));
+    new (&s) FunctionBase(std::move(tmp));
   }
 
+  void* Object() const;
+
 protected:
   template<typename F>
-  static void* CopyConstructor(void* func_copy_from, void* func_dest)
-  requires(!IsMoveOnly);
+  static void CopyLocal(const void* src, void* dest);
   template<typename F>
-  static void* CopyConstructor(void* func_copy_from, void* func_dest)
-  requires(IsMoveOnly) = delete;
+  static void CopyHeap(const void* src, void* dest);
+  template<typename F>
+  static void MoveLocal(void* src, void* dest);
   template<typename F>
-  static void* MoveConstrutor(void* func_move_from, void* func_dest);
+  static void DestroyLocal(void* storage);
   template<typename F>
-  static void Destroy(void* func, bool uses_local_storage);
+  static void DestroyHeap(void* storage);
   template<typename F>
   static auto Invoke(void* func, Args... args) -> Ret;
-
-
   template<typename F>
-  static function_detail::ControlBlockMethodsPtrs<IsMoveOnly, Ret, Args...>* get_control_block_F() {
-    const std::type_info& cur_inf = typeid(F);
-    if constexpr (!IsMoveOnly) {
-      static function_detail::ControlBlockMethodsPtrs<false, Ret, Args...> block = function_detail::ControlBlockMethodsPtrs<false, Ret, Args...>(
-        &FunctionBase::CopyConstructor< F >,
-        &FunctionBase::MoveConstrutor< F >,
-        &FunctionBase::Destroy< F >,
-        cur_inf
-      );
-      return &block;
-    } else {
-      static function_detail::ControlBlockMethodsPtrs<true, Ret, Args...> block = function_detail::ControlBlockMethodsPtrs<true, Ret, Args...>(
-        nullptr,
-        &FunctionBase::MoveConstrutor < F >,
-        &FunctionBase::Destroy < F >,
-        cur_inf
-      );
-      return &block;
-    }
+  static auto InvokeHeap(void* storage, Args... args) -> Ret;
+  static auto InvokeEmpty(void* storage, Args... args) -> Ret;
+
+  template<typename F, bool IsLocal>
+  static constexpr VTable MakeVTable();
+
+  template<typename F, bool IsLocal>
+  static constexpr VTable kVTable = MakeVTable<F, IsLocal>();
+  static constexpr VTable kEmptyVTable = {
+    .invoke = &InvokeEmpty,
+    .copy = nullptr,
+    .move = nullptr,
+    .destroy = nullptr,
+    .type_id = function_detail::TypeId<void>(),
+#ifndef FUNCTION_NO_RTTI
+    .type_info = &typeid(void),
+#endif
+    .is_local = true,
   };
 
 protected:
-  static constexpr int BUFFER_SIZE = 16;
-  void* func_ptr_;
-  invoke_ptr_t invoke_ptr_;
-  function_detail::ControlBlockMethodsPtrs<IsMoveOnly, Ret, Args...>* block_ptr_;
-  alignas(std::max_align_t) char buffer_[BUFFER_SIZE];
-  bool uses_local_storage_;
+  const VTable* vtable_;
+  alignas(BUFFER_ALIGN) unsigned char buffer_[BUFFER_SIZE];
 public:
-  FunctionBase(std::nullptr_t);
-  FunctionBase(): FunctionBase(nullptr) {}
+  FunctionBase(std::nullptr_t) noexcept;
+  FunctionBase() noexcept: FunctionBase(nullptr) {}
 
   FunctionBase(const FunctionBase& other)
   requires(!IsMoveOnly);
   FunctionBase(const FunctionBase& other)
   requires(IsMoveOnly) = delete;
-  FunctionBase(FunctionBase&& other);
+  FunctionBase(FunctionBase&& other) noexcept;
 
   template<typename Func>
   FunctionBase(Func&& func)
@@ -150,193 +172,276 @@ public:
   template<typename T>
   auto target() const -> const T*;
 
+#ifndef FUNCTION_NO_RTTI
   [[ nodiscard ]] auto target_type() const -> const std::type_info&;
+#endif
 
-  bool Empty() const { return invoke_ptr_ == nullptr; }
+  bool Empty() const { return vtable_ == &kEmptyVTable; }
   ~FunctionBase();
 };
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::operator=(FunctionBase other) -> FunctionBase & {
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::operator=(FunctionBase other) -> FunctionBase & {
   FunctionBase::SwapFuntions(*this, other);
   return *this;
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::target_type() const -> const std::type_info& {
-  if (!Empty()) {
-    return block_ptr_->type_info;
-  }
-  return typeid(void);
+#ifndef FUNCTION_NO_RTTI
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::target_type() const -> const std::type_info& {
+  return *vtable_->type_info;
 }
+#endif
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+void* FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::Object() const {
+  void* storage = const_cast<unsigned char*>(buffer_);
+  return vtable_->is_local ? storage : *static_cast<void**>(storage);
+}
+
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
 template<typename T>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::target() const -> const T * {
-  if (!Empty() && block_ptr_->type_info == typeid(T)) {
-    return static_cast<const T*>(func_ptr_);
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::target() const -> const T * {
+  if (!Empty() && vtable_->type_id == function_detail::TypeId<T>()) {
+    return static_cast<const T*>(Object());
   }
   return nullptr;
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
 template<typename T>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::target() -> T * {
-  if (!Empty() && block_ptr_->type_info == typeid(T)) {
-    return static_cast<T*>(func_ptr_);
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::target() -> T * {
+  if (!Empty() && vtable_->type_id == function_detail::TypeId<T>()) {
+    return static_cast<T*>(Object());
   }
   return nullptr;
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-FunctionBase<IsMoveOnly, Ret(Args...)>::operator bool() const {
-  return (invoke_ptr_ != nullptr);
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::operator bool() const {
+  return !Empty();
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
 template<typename Func>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::operator=(
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::operator=(
   Func &&func) -> FunctionBase &
 requires(!is_FunctionBase_v<std::remove_cvref_t<Func>>) {
-  FunctionBase tmp(func);
+  FunctionBase tmp(std::forward<Func>(func));
   SwapFuntions(*this, tmp);
   return *this;
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-FunctionBase<IsMoveOnly, Ret(Args...)>::FunctionBase(const FunctionBase &other)
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::FunctionBase(const FunctionBase &other)
 requires(!IsMoveOnly):
-  invoke_ptr_(other.invoke_ptr_),
-  block_ptr_(other.block_ptr_),
-  func_ptr_(nullptr),
-  uses_local_storage_(other.uses_local_storage_) {
-  if (other.Empty()) {
-    return;
-  }
-
-  if (other.uses_local_storage_) {
-    func_ptr_ = buffer_;
+  vtable_(other.vtable_) {
+  if (vtable_->copy == nullptr) {
+    std::memcpy(buffer_, other.buffer_, BUFFER_SIZE);
+  } else {
+    vtable_->copy(other.buffer_, buffer_);
   }
-  func_ptr_ = block_ptr_->copy_ptr(other.func_ptr_, func_ptr_);
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-FunctionBase<IsMoveOnly, Ret(Args...)>::FunctionBase(FunctionBase &&other):
-  invoke_ptr_(other.invoke_ptr_),
-  block_ptr_(other.block_ptr_),
-  func_ptr_(nullptr),
-  uses_local_storage_(other.uses_local_storage_) {
-  if (other.Empty()) {
-    return;
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::FunctionBase(FunctionBase &&other) noexcept:
+  vtable_(other.vtable_) {
+  // trivially relocatable callables and heap pointers are moved by memcpy
+  if (vtable_->move == nullptr) {
+    std::memcpy(buffer_, other.buffer_, BUFFER_SIZE);
+  } else {
+    vtable_->move(other.buffer_, buffer_);
   }
+  other.vtable_ = &kEmptyVTable;
+}
 
-  if (other.uses_local_storage_) {
-    func_ptr_ = buffer_;
-    func_ptr_ = block_ptr_->move_ptr(other.func_ptr_, func_ptr_);
-
-    other.block_ptr_->destroy_ptr(other.func_ptr_, other.uses_local_storage_);
-    other.func_ptr_ = nullptr;
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::FunctionBase(std::nullptr_t) noexcept:
+  vtable_(&kEmptyVTable) {}
+
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+template<typename F, bool IsLocal>
+constexpr auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::MakeVTable() -> VTable {
+  VTable vtable{};
+  vtable.type_id = function_detail::TypeId<F>();
+#ifndef FUNCTION_NO_RTTI
+  vtable.type_info = &typeid(F);
+#endif
+  vtable.is_local = IsLocal;
+  if constexpr (IsLocal) {
+    vtable.invoke = &FunctionBase::Invoke<F>;
+    if constexpr (!IsMoveOnly && !std::is_trivially_copyable_v<F>) {
+      vtable.copy = &FunctionBase::CopyLocal<F>;
+    }
+    if constexpr (!std::is_trivially_copyable_v<F>) {
+      vtable.move = &FunctionBase::MoveLocal<F>;
+    }
+    if constexpr (!std::is_trivially_destructible_v<F>) {
+      vtable.destroy = &FunctionBase::DestroyLocal<F>;
+    }
   } else {
-    func_ptr_ = other.func_ptr_,
-    other.func_ptr_ = nullptr;
+    vtable.invoke = &FunctionBase::InvokeHeap<F>;
+    if constexpr (!IsMoveOnly) {
+      vtable.copy = &FunctionBase::CopyHeap<F>;
+    }
+    vtable.destroy = &FunctionBase::DestroyHeap<F>;
   }
+  return vtable;
+}
 
-  other.block_ptr_ = nullptr;
-  other.invoke_ptr_ = nullptr;
-  other.uses_local_storage_ = false;
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+template<typename F>
+void FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::CopyLocal(const void* src, void* dest) {
+  new (dest) F(*static_cast<const F*>(src));
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-FunctionBase<IsMoveOnly, Ret(Args...)>::FunctionBase(std::nullptr_t):
-  func_ptr_(nullptr),
-  invoke_ptr_(nullptr),
-  block_ptr_(nullptr),
-  uses_local_storage_(false) {}
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+template<typename F>
+void FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::CopyHeap(const void* src, void* dest) {
+  *static_cast<F**>(dest) = new F(**static_cast<F* const*>(src));
+}
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
 template<typename F>
-void* FunctionBase<IsMoveOnly, Ret(Args...)>::MoveConstrutor(void *func_move_from, void *func_dest) {
-  F* src_F = static_cast<F*>(func_move_from);
-  F* dst_F = static_cast<F*>(func_dest);
-  if (func_dest != nullptr) {
-    new (dst_F) F(std::move(*src_F));
-  } else {
-    dst_F = new F(std::move(*src_F));
-  }
-  return static_cast<void*>(dst_F);
+void FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::MoveLocal(void* src, void* dest) {
+  F* src_F = static_cast<F*>(src);
+  new (dest) F(std::move(*src_F));
+  src_F->~F();
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
 template<typename F>
-void* FunctionBase<IsMoveOnly, Ret(Args...)>::CopyConstructor(void* func_copy_from, void* func_dest)
-requires(!IsMoveOnly) {
-  F* func_dest_F = static_cast<F*>(func_dest);
-  F* func_src_F = static_cast<F*>(func_copy_from);
-  if (func_dest != nullptr) {
-    new (func_dest_F) F(*func_src_F);
-  } else {
-    func_dest_F = new F(*func_src_F);
-  }
-  return static_cast<void*>(func_dest_F);
+void FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::DestroyLocal(void* storage) {
+  static_cast<F*>(storage)->~F();
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+template<typename F>
+void FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::DestroyHeap(void* storage) {
+  delete *static_cast<F**>(storage);
+}
+
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
 template<typename Func>
-FunctionBase<IsMoveOnly, Ret(Args...)>::FunctionBase(Func &&func)
+FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::FunctionBase(Func &&func)
 requires(!is_FunctionBase_v<std::remove_cvref_t<Func>>) {
-  using FuncType = std::remove_cvref_t<Func>;
-  using StoredType = FuncType;
-
-  invoke_ptr_ = &FunctionBase::Invoke<StoredType>;
-  block_ptr_ = get_control_block_F<StoredType>();
+  using StoredType = std::decay_t<Func>;
 
-  constexpr bool fits = (sizeof(StoredType) <= BUFFER_SIZE) &&
-                        (alignof(StoredType) <= alignof(decltype(buffer_)));
+  constexpr bool fits = FitsLocal<StoredType>();
+  static_assert(AllowHeap || fits,
+                "callable does not fit in inline buffer of InplaceFunction or its move may throw");
 
-  void* dest = (fits ? static_cast<void*>(buffer_) : nullptr);
-
-  if constexpr (std::is_lvalue_reference_v<Func>) {
-    func_ptr_ = block_ptr_->copy_ptr(&func, dest);
+  if constexpr (fits) {
+    new (buffer_) StoredType(std::forward<Func>(func));
   } else {
-    func_ptr_ = block_ptr_->move_ptr(&func, dest);
+    *reinterpret_cast<StoredType**>(buffer_) = new StoredType(std::forward<Func>(func));
   }
-  uses_local_storage_ = (func_ptr_ == buffer_);
+  vtable_ = &kVTable<StoredType, fits>;
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
 template <typename F>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::Invoke(void* func, Args... args) -> Ret {
-  return std::invoke(*static_cast<F*>(func), std::forward<Args>(args)...);
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::Invoke(void* func, Args... args) -> Ret {
+  return function_detail::Invoke<F, Ret, Args...>(func, std::forward<Args>(args)...);
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::operator()(Args... args) const -> Ret {
-  if (Empty()) {
-    throw std::bad_function_call();
-  }
-  return invoke_ptr_(func_ptr_, std::forward<Args>(args)...);
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+template <typename F>
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::InvokeHeap(void* storage, Args... args) -> Ret {
+  return Invoke<F>(*static_cast<void**>(storage), std::forward<Args>(args)...);
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-FunctionBase<IsMoveOnly, Ret(Args...)>::~FunctionBase() {
-  if (!Empty()) {
-    block_ptr_->destroy_ptr(func_ptr_, uses_local_storage_);
-  }
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::InvokeEmpty(void*, Args...) -> Ret {
+#ifdef FUNCTION_NO_EXCEPTIONS
+  assert(false && "empty function called");
+  std::abort();
+#else
+  throw std::bad_function_call();
+#endif
 }
 
-template<bool IsMoveOnly, typename Ret, typename... Args>
-template <typename F>
-auto FunctionBase<IsMoveOnly, Ret(Args...)>::Destroy(void* func, bool uses_local_storage) -> void {
-  if (uses_local_storage) {
-    static_cast<F*>(func)->~F();
-  } else {
-    delete static_cast<F*>(func);
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+auto FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::operator()(Args... args) const -> Ret {
+  // empty function has its own table that throws or aborts, so there is no branch here
+  return vtable_->invoke(const_cast<unsigned char*>(buffer_), std::forward<Args>(args)...);
+}
+
+template<bool IsMoveOnly, typename Ret, typename... Args, size_t BufferSize, bool AllowHeap>
+FunctionBase<IsMoveOnly, Ret(Args...), BufferSize, AllowHeap>::~FunctionBase() {
+  if (vtable_->destroy != nullptr) {
+    vtable_->destroy(buffer_);
   }
 }
 
-template<typename T>
-using Function = FunctionBase<false, T>;
+template<typename T, size_t BufferSize = 16>
+using Function = FunctionBase<false, T, BufferSize>;
+
+template<typename T, size_t BufferSize = 16>
+using MoveOnlyFunction = FunctionBase<true, T, BufferSize>;
+
+// never allocates: callable bigger than BufferSize does not compile
+template<typename T, size_t BufferSize = 64>
+using InplaceFunction = FunctionBase<false, T, BufferSize, false>;
+
+template<typename T, size_t BufferSize = 64>
+using MoveOnlyInplaceFunction = FunctionBase<true, T, BufferSize, false>;
 
+// Non-owning callable reference for synchronous callbacks: object pointer and trampoline,
+// never allocates. Referenced callable must outlive the FunctionRef.
 template<typename T>
-using MoveOnlyFunction = FunctionBase<true, T>;
+class FunctionRef {};
 
+template<typename Ret, typename... Args>
+class FunctionRef<Ret(Args...)> {
+public:
+  template<typename Func>
+  FunctionRef(Func&& func) noexcept
+  requires(!std::is_same_v<std::remove_cvref_t<Func>, FunctionRef> &&
+           std::is_invocable_r_v<Ret, Func&, Args...>);
+
+  FunctionRef(const FunctionRef& other) = default;
+  FunctionRef& operator=(const FunctionRef& other) = default;
+
+  Ret operator()(Args... args) const;
+private:
+  using invoke_ptr_t = Ret(*)(void*, Args...);
+
+  template<typename FuncPtr>
+  static auto InvokeFunction(void* func, Args... args) -> Ret;
+
+  void* object_;
+  invoke_ptr_t invoke_ptr_;
+};
+
+template<typename Ret, typename... Args>
+template<typename Func>
+FunctionRef<Ret(Args...)>::FunctionRef(Func&& func) noexcept
+requires(!std::is_same_v<std::remove_cvref_t<Func>, FunctionRef> &&
+         std::is_invocable_r_v<Ret, Func&, Args...>) {
+  using FuncType = std::remove_reference_t<Func>;
+  using FuncPtr = std::decay_t<Func>;
+  if constexpr (std::is_pointer_v<FuncPtr> && std::is_function_v<std::remove_pointer_t<FuncPtr>>) {
+    // plain function has no object to point to, its own address is kept instead
+    object_ = reinterpret_cast<void*>(static_cast<FuncPtr>(func));
+    invoke_ptr_ = &FunctionRef::InvokeFunction<FuncPtr>;
+  } else {
+    object_ = const_cast<void*>(static_cast<const volatile void*>(std::addressof(func)));
+    invoke_ptr_ = &function_detail::Invoke<FuncType, Ret, Args...>;
+  }
+}
+
+template<typename Ret, typename... Args>
+template<typename FuncPtr>
+auto FunctionRef<Ret(Args...)>::InvokeFunction(void* func, Args... args) -> Ret {
+  if constexpr (std::is_void_v<Ret>) {
+    std::invoke(reinterpret_cast<FuncPtr>(func), std::forward<Args>(args)...);
+  } else {
+    return std::invoke(reinterpret_cast<FuncPtr>(func), std::forward<Args>(args)...);
+  }
+}
+
+template<typename Ret, typename... Args>
+auto FunctionRef<Ret(Args...)>::operator()(Args... args) const -> Ret {
+  return invoke_ptr_(object_, std::forward<Args>(args)...);
+}
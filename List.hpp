@@ -2,11 +2,24 @@
 #include <exception>
 #include <memory>
 #include <iostream>
+#include <type_traits>
+#include <cassert>
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 class UnorderedMap;
 
 namespace list_detail {
+  // allocators that release memory all at once mark themselves with is_deallocate_noop = std::true_type
+  template<typename Alloc, typename = void>
+  struct is_deallocate_noop : std::false_type {};
+
+  template<typename Alloc>
+  struct is_deallocate_noop<Alloc, std::void_t<typename Alloc::is_deallocate_noop>> : Alloc::is_deallocate_noop {};
+
+  // allocator that defines destroy() must see it called even for trivially destructible nodes
+  template<typename Alloc, typename T>
+  constexpr bool has_custom_destroy_v = requires(Alloc& alloc, T* ptr) { alloc.destroy(ptr); };
+
   template<typename T>
   struct BaseNode {
     BaseNode *prev;
@@ -123,6 +136,20 @@ private:
   void DestroyHead(BaseNodeType* ptr);
   void init(uint32_t n, const AllocT& alloc, const T& val);
 
+  // allocator is taken from other list when it converts, allocators without default constructor must convert
+  template<typename AnotherAllocT>
+  static AllocT ConvertAllocator(const AnotherAllocT& other) {
+    if constexpr (std::is_constructible_v<AllocT, const AnotherAllocT&>) {
+      return AllocT(other);
+    } else {
+      return AllocT{};
+    }
+  }
+  template<typename AnotherAllocT>
+  static AllocT CopyAllocator(const AnotherAllocT& other) {
+    return std::allocator_traits<AllocT>::select_on_container_copy_construction(ConvertAllocator(other));
+  }
+
   template<typename AnotherAllocT = std::allocator<T>>
   void copy_from(const List<T, AnotherAllocT>& other);
 
@@ -151,12 +178,12 @@ public:
 
 
   template<typename AnotherAllocT = std::allocator<T>>
-  List(const List<T, AnotherAllocT>& other) { copy_from(other); }
-  List(const List& other) { copy_from(other); }
+  List(const List<T, AnotherAllocT>& other): alloc_(CopyAllocator(other.alloc_)) { copy_from(other); }
+  List(const List& other): alloc_(CopyAllocator(other.alloc_)) { copy_from(other); }
 
   template<typename AnotherAllocT = std::allocator<T>>
-  List(List<T, AnotherAllocT>&& other) { move_from(std::move(other)); }
-  List(List&& other) { move_from(std::move(other)); }
+  List(List<T, AnotherAllocT>&& other): alloc_(ConvertAllocator(other.alloc_)) { move_from(std::move(other)); }
+  List(List&& other): alloc_(other.alloc_) { move_from(std::move(other)); }
 
   template<typename AnotherAllocT = std::allocator<T>>
   void swap(List<T, AnotherAllocT>& other) {
@@ -229,7 +256,7 @@ public:
   template<typename U, typename AllocU>
   friend class List;
 
-  template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+  template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
   friend class UnorderedMap;
 };
 
@@ -348,6 +375,15 @@ void List<T, AllocT>::move_assign_from(List<T, AnotherAllocT> &&other) {
 template<typename T, typename AllocT>
 template<typename AnotherAllocT>
 void List<T, AllocT>::move_from(List<T, AnotherAllocT> &&other) {
+  // stolen nodes must be returned to the allocator that created them
+  if constexpr (std::is_constructible_v<AllocT, const AnotherAllocT&>) {
+    alloc_ = AllocT(other.alloc_);
+  }
+  if (other.size_ == 0) {
+    fake_node_.prev = fake_node_.next = &fake_node_;
+    size_ = 0;
+    return;
+  }
   fake_node_.next = other.fake_node_.next;
   fake_node_.next->prev = &fake_node_;
 
@@ -367,12 +403,23 @@ List<T, AllocT>::List(): size_(0) {
 
 template<typename T, typename AllocT>
 void List<T, AllocT>::DestroyHead(List<T, AllocT>::BaseNodeType* ptr) {
+  constexpr bool skip_deallocate = list_detail::is_deallocate_noop<DefaultNodeAlloc>::value;
+  constexpr bool skip_destroy = std::is_trivially_destructible_v<DefaultNodeType> &&
+                                !list_detail::has_custom_destroy_v<DefaultNodeAlloc, DefaultNodeType>;
+  if constexpr (skip_deallocate && skip_destroy) {
+    // nothing to run per node, memory goes back with the whole arena
+    fake_node_.prev = &fake_node_;
+    fake_node_.next = &fake_node_;
+    return;
+  }
   DefaultNodeAlloc node_alloc(alloc_);
   BaseNodeType* cur_destroy_node = ptr;
   BaseNodeType* next_destroy_node = ptr->prev;
   while (cur_destroy_node != &fake_node_) {
     std::allocator_traits<DefaultNodeAlloc>::destroy(node_alloc, static_cast<DefaultNodeType*>(cur_destroy_node));
-    std::allocator_traits<DefaultNodeAlloc>::deallocate(node_alloc, static_cast<DefaultNodeType*>(cur_destroy_node), 1); // need dynamic cast?
+    if constexpr (!skip_deallocate) {
+      std::allocator_traits<DefaultNodeAlloc>::deallocate(node_alloc, static_cast<DefaultNodeType*>(cur_destroy_node), 1); // need dynamic cast?
+    }
 
     cur_destroy_node = next_destroy_node;
     next_destroy_node = next_destroy_node->prev;
@@ -466,6 +513,7 @@ void List<T, AllocT>::assign_from(const List<T, AnotherAllocT>& other) {
     cur_node = cur_node->next;
     cur_other_node = cur_other_node->next;
   }
+  fake_node_.prev = cur_node;
   alloc_ = new_alloc;
   size_ = other.size_;
 }
@@ -473,12 +521,7 @@ void List<T, AllocT>::assign_from(const List<T, AnotherAllocT>& other) {
 template<typename T, typename AllocT>
 template<typename AnotherAllocT>
 void List<T, AllocT>::copy_from(const List<T, AnotherAllocT>& other) {
-  if constexpr (std::is_constructible_v<AllocT, const AnotherAllocT&>) {
-    AllocT tmp(other.get_allocator());
-    alloc_ = std::allocator_traits<AllocT>::select_on_container_copy_construction(tmp);
-  } else {
-    alloc_ = std::allocator_traits<AllocT>::select_on_container_copy_construction(AllocT{});
-  }
+  alloc_ = CopyAllocator(other.get_allocator());
 
   const typename List<T, AnotherAllocT>::BaseNodeType* cur_other = other.fake_node_.next;
 
@@ -0,0 +1,264 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Allocator for node based containers: every single node allocation is taken from big slabs,
+// freed nodes go to free list of its size class and are reused by next allocation.
+// Copies and rebinds of one allocator share one storage, so List and UnorderedMap can rebind it to node types.
+// Every default constructed allocator creates its own storage: containers that should share a pool
+// must be given copies of one allocator.
+
+namespace pool_detail {
+  class PoolStorage {
+  public:
+    static constexpr size_t kGranularity = alignof(std::max_align_t);
+    static constexpr size_t kMaxBlockSize = 512;
+    static constexpr size_t kSlabSize = 64 * 1024;
+
+    PoolStorage() = default;
+    PoolStorage(const PoolStorage& other) = delete;
+    PoolStorage& operator=(const PoolStorage& other) = delete;
+    ~PoolStorage();
+
+    static bool IsPooled(size_t size, size_t align) { return size <= kMaxBlockSize && align <= kGranularity; }
+
+    void* Allocate(size_t size);
+    void Deallocate(void* ptr, size_t size);
+
+    // number of allocators that use this storage, storage is not shared between threads
+    uint32_t ref_cnt = 0;
+  private:
+    struct FreeBlock {
+      FreeBlock* next;
+    };
+    struct Slab {
+      Slab* next;
+    };
+    struct SizeClass {
+      FreeBlock* free_list = nullptr;
+      char* cur = nullptr;
+      char* end = nullptr;
+    };
+
+    static size_t ClassIndex(size_t size) { return (size == 0 ? 0 : (size - 1) / kGranularity); }
+    void Refill(SizeClass& size_class, size_t block_size);
+
+    SizeClass classes_[kMaxBlockSize / kGranularity];
+    Slab* slabs_ = nullptr;
+  };
+
+  inline PoolStorage::~PoolStorage() {
+    while (slabs_ != nullptr) {
+      Slab* next = slabs_->next;
+      ::operator delete(static_cast<void*>(slabs_));
+      slabs_ = next;
+    }
+  }
+
+  inline void PoolStorage::Refill(SizeClass& size_class, size_t block_size) {
+    // slab header takes one granule so blocks stay aligned as max_align_t
+    size_t slab_size = std::max(kSlabSize, block_size + kGranularity);
+    char* memory = static_cast<char*>(::operator new(slab_size));
+    Slab* slab = reinterpret_cast<Slab*>(memory);
+    slab->next = slabs_;
+    slabs_ = slab;
+
+    size_class.cur = memory + kGranularity;
+    size_class.end = memory + slab_size;
+  }
+
+  inline void* PoolStorage::Allocate(size_t size) {
+    SizeClass& size_class = classes_[ClassIndex(size)];
+    if (size_class.free_list != nullptr) {
+      FreeBlock* block = size_class.free_list;
+      size_class.free_list = block->next;
+      return block;
+    }
+    size_t block_size = (ClassIndex(size) + 1) * kGranularity;
+    if (static_cast<size_t>(size_class.end - size_class.cur) < block_size) {
+      Refill(size_class, block_size);
+    }
+    void* res = size_class.cur;
+    size_class.cur += block_size;
+    return res;
+  }
+
+  inline void PoolStorage::Deallocate(void* ptr, size_t size) {
+    SizeClass& size_class = classes_[ClassIndex(size)];
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = size_class.free_list;
+    size_class.free_list = block;
+  }
+}
+
+template<typename T>
+class PoolAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  PoolAllocator();
+  PoolAllocator(const PoolAllocator& other) noexcept;
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>& other) noexcept;
+
+  PoolAllocator& operator=(PoolAllocator other) noexcept;
+
+  T* allocate(size_t n);
+  void deallocate(T* ptr, size_t n);
+
+  template<typename U>
+  bool operator==(const PoolAllocator<U>& other) const { return storage_ == other.storage_; }
+  template<typename U>
+  bool operator!=(const PoolAllocator<U>& other) const { return storage_ != other.storage_; }
+
+  ~PoolAllocator();
+private:
+  pool_detail::PoolStorage* storage_;
+
+  template<typename U>
+  friend class PoolAllocator;
+};
+
+template<typename T>
+PoolAllocator<T>::PoolAllocator(): storage_(new pool_detail::PoolStorage()) {
+  ++storage_->ref_cnt;
+}
+
+template<typename T>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator& other) noexcept: storage_(other.storage_) {
+  ++storage_->ref_cnt;
+}
+
+template<typename T>
+template<typename U>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator<U>& other) noexcept: storage_(other.storage_) {
+  ++storage_->ref_cnt;
+}
+
+template<typename T>
+PoolAllocator<T>& PoolAllocator<T>::operator=(PoolAllocator other) noexcept {
+  std::swap(storage_, other.storage_);
+  return *this;
+}
+
+template<typename T>
+PoolAllocator<T>::~PoolAllocator() {
+  if (--storage_->ref_cnt == 0) {
+    delete storage_;
+  }
+}
+
+template<typename T>
+T* PoolAllocator<T>::allocate(size_t n) {
+  // arrays go to std::allocator, so size classes hold only nodes
+  if (n == 1 && pool_detail::PoolStorage::IsPooled(sizeof(T), alignof(T))) {
+    return static_cast<T*>(storage_->Allocate(sizeof(T)));
+  }
+  return std::allocator<T>().allocate(n);
+}
+
+template<typename T>
+void PoolAllocator<T>::deallocate(T* ptr, size_t n) {
+  if (n == 1 && pool_detail::PoolStorage::IsPooled(sizeof(T), alignof(T))) {
+    storage_->Deallocate(ptr, sizeof(T));
+    return;
+  }
+  std::allocator<T>().deallocate(ptr, n);
+}
+
+// Stateless allocator with per-thread free list of single blocks for each type.
+// Freed block is kept for next allocation of same type, cached blocks are released on thread exit.
+template<typename T>
+class TypePoolAllocator {
+public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  static constexpr size_t kMaxCached = 4096;
+
+  TypePoolAllocator() noexcept = default;
+  template<typename U>
+  TypePoolAllocator(const TypePoolAllocator<U>&) noexcept {}
+
+  T* allocate(size_t n);
+  void deallocate(T* ptr, size_t n);
+
+  template<typename U>
+  bool operator==(const TypePoolAllocator<U>&) const { return true; }
+  template<typename U>
+  bool operator!=(const TypePoolAllocator<U>&) const { return false; }
+private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+  struct FreeList {
+    FreeBlock* head = nullptr;
+    size_t cnt = 0;
+
+    ~FreeList();
+  };
+
+  static constexpr bool kPooled = sizeof(T) >= sizeof(FreeBlock) && alignof(T) >= alignof(FreeBlock);
+
+  // flag has trivial destructor, so it can be read after list is gone
+  static bool& ListDestroyed() {
+    thread_local bool destroyed = false;
+    return destroyed;
+  }
+  // nullptr once list is destroyed: objects released during thread exit or static destruction
+  // go straight to std::allocator
+  static FreeList* LocalList() {
+    if (ListDestroyed()) {
+      return nullptr;
+    }
+    thread_local FreeList list;
+    return &list;
+  }
+};
+
+template<typename T>
+TypePoolAllocator<T>::FreeList::~FreeList() {
+  ListDestroyed() = true;
+  while (head != nullptr) {
+    FreeBlock* next = head->next;
+    std::allocator<T>().deallocate(reinterpret_cast<T*>(head), 1);
+    head = next;
+  }
+}
+
+template<typename T>
+T* TypePoolAllocator<T>::allocate(size_t n) {
+  if constexpr (kPooled) {
+    FreeList* list = LocalList();
+    if (n == 1 && list != nullptr && list->head != nullptr) {
+      FreeBlock* block = list->head;
+      list->head = block->next;
+      --list->cnt;
+      return reinterpret_cast<T*>(block);
+    }
+  }
+  return std::allocator<T>().allocate(n);
+}
+
+template<typename T>
+void TypePoolAllocator<T>::deallocate(T* ptr, size_t n) {
+  if constexpr (kPooled) {
+    FreeList* list = LocalList();
+    if (n == 1 && list != nullptr && list->cnt < kMaxCached) {
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(ptr);
+      block->next = list->head;
+      list->head = block;
+      ++list->cnt;
+      return;
+    }
+  }
+  std::allocator<T>().deallocate(ptr, n);
+}
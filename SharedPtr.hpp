@@ -1,14 +1,25 @@
+#pragma once
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <cassert>
 #include <cstring>
+#include <atomic>
+#include <stdexcept>
+#include "PoolAllocator.hpp"
 
-template<typename T>
+struct SingleThreadPolicy;
+
+template<typename T, typename Policy = SingleThreadPolicy>
 class WeakPtr;
-template<typename T>
+template<typename T, typename Policy = SingleThreadPolicy>
 class EnableSharedFromThis;
-template<typename T>
+template<typename T, typename Policy = SingleThreadPolicy>
 class SharedPtr;
+template<typename T>
+class AtomicSharedPtr;
+template<typename T>
+class IntrusivePtr;
 
 namespace smartptr_traits {
   template<size_t N, typename... Args>
@@ -25,8 +36,16 @@ namespace smartptr_traits {
   };
   template<typename T>
   struct is_shared_ptr : std::false_type {};
-  template<typename T>
-  struct is_shared_ptr<SharedPtr<T>> : std::true_type {};
+  template<typename T, typename Policy>
+  struct is_shared_ptr<SharedPtr<T, Policy>> : std::true_type {};
+
+  // makeSharedForOverwrite: object is default initialized instead of value initialized
+  struct for_overwrite_t {};
+  inline constexpr for_overwrite_t for_overwrite{};
+
+  // allocator that defines destroy() must see it called even for trivially destructible objects
+  template<typename Alloc, typename T>
+  constexpr bool has_custom_destroy_v = requires(Alloc& alloc, T* ptr) { alloc.destroy(ptr); };
 
   template<size_t N, typename... Args>
   using get_type_t = typename get_type<N, Args...>::type;
@@ -41,20 +60,109 @@ struct Debug {
   Debug() = delete;
 };
 
-struct ControlBlockBase {
-  int32_t shared_cnt;
-  int32_t weak_cnt;
-  ControlBlockBase(): shared_cnt(0), weak_cnt(0) {}
+// default policy: plain counters, pointers to one object must stay in one thread
+struct SingleThreadPolicy {
+  using CounterType = uint64_t;
 
-  virtual void destroy_obj() = 0;
-  virtual void delete_self() = 0;
+  static uint64_t FetchAdd(CounterType& cnt, uint64_t delta) {
+    uint64_t old = cnt;
+    cnt += delta;
+    return old;
+  }
+  static uint64_t FetchSub(CounterType& cnt, uint64_t delta) {
+    uint64_t old = cnt;
+    cnt -= delta;
+    return old;
+  }
+  static uint64_t Load(const CounterType& cnt) { return cnt; }
+  static bool CompareExchangeWeak(CounterType& cnt, uint64_t& expected, uint64_t desired) {
+    if (cnt != expected) {
+      expected = cnt;
+      return false;
+    }
+    cnt = desired;
+    return true;
+  }
+};
 
-  virtual ~ControlBlockBase() = default;
+// pointers to one object can be copied and destroyed from different threads
+struct AtomicPolicy {
+  using CounterType = std::atomic<uint64_t>;
+
+  static uint64_t FetchAdd(CounterType& cnt, uint64_t delta) { return cnt.fetch_add(delta, std::memory_order_relaxed); }
+  // release makes our writes to object visible, acquire on last decrement sees writes of all other owners
+  static uint64_t FetchSub(CounterType& cnt, uint64_t delta) { return cnt.fetch_sub(delta, std::memory_order_acq_rel); }
+  static uint64_t Load(const CounterType& cnt) { return cnt.load(std::memory_order_acquire); }
+  static bool CompareExchangeWeak(CounterType& cnt, uint64_t& expected, uint64_t desired) {
+    return cnt.compare_exchange_weak(expected, desired, std::memory_order_acq_rel, std::memory_order_relaxed);
+  }
 };
 
-template<typename T>
+// No vtable: concrete block passes its static Manage function, last release makes one indirect call.
+template<typename Policy>
+struct ControlBlockBase {
+  enum class Op {
+    kDestroyObj,
+    kDeleteSelf,
+    kDestroyAndDelete
+  };
+  using ManagerType = void (*)(ControlBlockBase*, Op);
+
+  static constexpr uint64_t kOneShared = 1;
+  static constexpr uint64_t kOneWeak = uint64_t(1) << 32;
+  static constexpr uint64_t kSharedMask = kOneWeak - 1;
+
+  // shared count in low half, weak count in high half.
+  // all shared owners together hold one weak reference, so only one thread sees weak count drop to zero
+  typename Policy::CounterType counts;
+  ManagerType manager;
+
+  explicit ControlBlockBase(ManagerType manager): counts(kOneWeak), manager(manager) {}
+
+  void AddShared() { Policy::FetchAdd(counts, kOneShared); }
+  void AddWeak() { Policy::FetchAdd(counts, kOneWeak); }
+  // for WeakPtr::lock, fails if object is already destroyed
+  bool TryAddShared();
+  void ReleaseShared();
+  void ReleaseWeak();
+  int32_t SharedCount() const { return static_cast<int32_t>(Policy::Load(counts) & kSharedMask); }
+};
+
+template<typename Policy>
+bool ControlBlockBase<Policy>::TryAddShared() {
+  uint64_t cur = Policy::Load(counts);
+  while ((cur & kSharedMask) != 0) {
+    if (Policy::CompareExchangeWeak(counts, cur, cur + kOneShared)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<typename Policy>
+void ControlBlockBase<Policy>::ReleaseShared() {
+  uint64_t old = Policy::FetchSub(counts, kOneShared);
+  if (old == kOneShared + kOneWeak) {
+    // no WeakPtr exists and new one can not appear, block is ours alone
+    manager(this, Op::kDestroyAndDelete);
+  } else if ((old & kSharedMask) == kOneShared) {
+    manager(this, Op::kDestroyObj);
+    ReleaseWeak();
+  }
+}
+
+template<typename Policy>
+void ControlBlockBase<Policy>::ReleaseWeak() {
+  if (Policy::FetchSub(counts, kOneWeak) == kOneWeak) {
+    manager(this, Op::kDeleteSelf);
+  }
+}
+
+template<typename T, typename Policy>
 class SharedPtr {
 public:
+  using element_type = std::remove_extent_t<T>;
+
   SharedPtr() noexcept: val_ptr_(nullptr), block_ptr_(nullptr) {}
   explicit SharedPtr(T* ptr);
   template<typename U>
@@ -62,23 +170,34 @@ public:
 
   template<typename... Args>
   explicit SharedPtr(Args&&... args) requires(
+    !std::is_array_v<T> &&
     sizeof...(Args) > 0 &&
     (sizeof...(Args) != 1 || !smartptr_traits::is_shared_ptr_v< std::decay_t<typename smartptr_traits::get_type_t<0, Args...>> >)
   );
   template<typename Alloc, typename... Args>
   explicit SharedPtr(std::allocator_arg_t, Alloc alloc, Args&&... args) requires(
-    sizeof...(Args) > 0 &&
+    !std::is_array_v<T> &&
     (sizeof...(Args) != 1 || !smartptr_traits::is_shared_ptr_v< std::decay_t<typename smartptr_traits::get_type_t<0, Args...>> >)
   );
+  explicit SharedPtr(smartptr_traits::for_overwrite_t) requires(!std::is_array_v<T>);
+
+  // SharedPtr<T[]>: control block and n elements are in one allocation
+  explicit SharedPtr(size_t n) requires(std::is_unbounded_array_v<T>);
+  SharedPtr(size_t n, const element_type& val) requires(std::is_unbounded_array_v<T>);
+  SharedPtr(smartptr_traits::for_overwrite_t, size_t n) requires(std::is_unbounded_array_v<T>);
+  template<typename Alloc>
+  SharedPtr(std::allocator_arg_t, Alloc alloc, size_t n) requires(std::is_unbounded_array_v<T>);
+  template<typename Alloc>
+  SharedPtr(std::allocator_arg_t, Alloc alloc, size_t n, const element_type& val) requires(std::is_unbounded_array_v<T>);
 
   SharedPtr(const SharedPtr& other);
   SharedPtr(SharedPtr&& other) noexcept;
 
   template<typename U>
-  SharedPtr(const SharedPtr<U>& other)
+  SharedPtr(const SharedPtr<U, Policy>& other)
   requires(std::is_base_of_v<T, U>);
   template<typename U>
-  SharedPtr(SharedPtr<U>&& other) noexcept
+  SharedPtr(SharedPtr<U, Policy>&& other) noexcept
   requires(std::is_base_of_v<T, U>);
 
   SharedPtr& operator=(SharedPtr other);
@@ -95,21 +214,26 @@ public:
   SharedPtr(U* ptr, DeleterU deleter, AllocU alloc);
 
   template<typename U>
-  SharedPtr(SharedPtr<U> const& r, T* ptr) noexcept;
+  SharedPtr(SharedPtr<U, Policy> const& r, element_type* ptr) noexcept;
 
-  T* get() const { return val_ptr_; }
-  T* operator->() const { return  val_ptr_; }
+  element_type* get() const { return val_ptr_; }
+  element_type* operator->() const { return  val_ptr_; }
+  element_type& operator[](size_t idx) const requires(std::is_unbounded_array_v<T>) { return val_ptr_[idx]; }
   ~SharedPtr();
 private:
+  using BlockBase = ControlBlockBase<Policy>;
+  using BlockOp = typename BlockBase::Op;
+
   template<typename U, typename DeleterU = std::default_delete<U>, typename AllocU = std::allocator<U>>
-  struct ControlBlockRegular : ControlBlockBase {
+  struct ControlBlockRegular : BlockBase {
     using ControlBlockRegularAlloc = std::allocator_traits<AllocU>::template rebind_alloc< ControlBlockRegular<U, DeleterU, AllocU> >;
     U* ptr;
     [[ no_unique_address ]] AllocU alloc;
     [[ no_unique_address ]] DeleterU deleter;
 
-    void destroy_obj() override;
-    void delete_self() override;
+    void destroy_obj();
+    void delete_self();
+    static void Manage(BlockBase* block, BlockOp op);
 
     ControlBlockRegular();
     explicit ControlBlockRegular(U* ptr);
@@ -123,83 +247,105 @@ private:
 
     auto operator=(ControlBlockRegular other) -> ControlBlockRegular&;
 
-    ~ControlBlockRegular() override;
+    ~ControlBlockRegular() = default;
   };
 
   template<typename U, typename AllocU = std::allocator<U>>
-  struct ControlBlockMakeShared : ControlBlockBase {
+  struct ControlBlockMakeShared : BlockBase {
     using ControlBlockSharedAlloc = std::allocator_traits<AllocU>::template rebind_alloc< ControlBlockMakeShared<U, AllocU> >;
     alignas(U) unsigned char storage[sizeof(U)];
     [[ no_unique_address]] AllocU alloc;
 
-    void destroy_obj() override;
-    void delete_self() override;
+    void destroy_obj();
+    void delete_self();
+    static void Manage(BlockBase* block, BlockOp op);
     U* val_ptr() { return reinterpret_cast<U*>(&storage); }
 
     template<typename... Args>
     explicit ControlBlockMakeShared(Args&&... args);
     template<typename... Args>
     explicit ControlBlockMakeShared(std::allocator_arg_t, AllocU alloc, Args&&... args);
+    explicit ControlBlockMakeShared(smartptr_traits::for_overwrite_t);
 
     ControlBlockMakeShared(const ControlBlockMakeShared& other) = delete;
     ControlBlockMakeShared(ControlBlockMakeShared&& other) = delete;
 
     ControlBlockMakeShared& operator=(ControlBlockMakeShared other) = delete;
 
-    ~ControlBlockMakeShared() override = default;
+    ~ControlBlockMakeShared() = default;
   };
 
-  T* val_ptr_;
-  ControlBlockBase* block_ptr_;
+  // elements are placed right after block, block alignment is raised to element alignment
+  // (alignas may not lower natural alignment of block, so it is the max of both)
+  template<typename AllocU>
+  struct alignas(std::max({alignof(element_type), alignof(BlockBase), alignof(size_t), alignof(AllocU)})) ControlBlockMakeSharedArray : BlockBase {
+    using BlockAlloc = std::allocator_traits<AllocU>::template rebind_alloc< ControlBlockMakeSharedArray<AllocU> >;
+    using ElemAlloc = std::allocator_traits<AllocU>::template rebind_alloc<element_type>;
+    size_t size;
+    [[ no_unique_address ]] AllocU alloc;
 
-  template<typename U>
+    void destroy_obj();
+    void delete_self();
+    static void Manage(BlockBase* block, BlockOp op);
+    element_type* val_ptr() { return reinterpret_cast<element_type*>(this + 1); }
+    // allocation is counted in blocks, so allocator sees only block type
+    static size_t BlockCount(size_t n) {
+      return 1 + (n * sizeof(element_type) + sizeof(ControlBlockMakeSharedArray) - 1) / sizeof(ControlBlockMakeSharedArray);
+    }
+
+    explicit ControlBlockMakeSharedArray(AllocU alloc): BlockBase(&Manage), size(0), alloc(alloc) {}
+  };
+
+  element_type* val_ptr_;
+  BlockBase* block_ptr_;
+
+  // construct_elem(elem_alloc, ptr) builds one element, already built ones are destroyed if it throws
+  template<typename AllocU, typename ConstructElem>
+  void InitArray(AllocU alloc, size_t n, ConstructElem construct_elem);
+
+  template<typename U, typename P>
   friend class WeakPtr;
-  template<typename U>
+  template<typename U, typename P>
   friend class SharedPtr;
 
   template<typename U>
-  SharedPtr(const WeakPtr<U>& other);
+  SharedPtr(const WeakPtr<U, Policy>& other);
   template<typename U>
-  SharedPtr(WeakPtr<U>&& other);
+  SharedPtr(WeakPtr<U, Policy>&& other);
 
   void SwapSharedPtr(SharedPtr& other);
 
-  template<typename Ptr>
-  friend void DeleteObjIfNeeded(const Ptr& smart_ptr);
-  template<typename U>
+  template<typename U, typename P>
   friend class EnableSharedFromThis;
-
-  SharedPtr(T* val_ptr, ControlBlockBase* block_ptr): val_ptr_(val_ptr), block_ptr_(block_ptr) {
-    ++block_ptr_->shared_cnt;
-  }
+  template<typename U>
+  friend class AtomicSharedPtr;
 };
 
-template<typename T>
-void SharedPtr<T>::reset(std::nullptr_t) {
+template<typename T, typename Policy>
+void SharedPtr<T, Policy>::reset(std::nullptr_t) {
   if (!block_ptr_) {
     return;
   }
-  --block_ptr_->shared_cnt;
-  DeleteObjIfNeeded(*this);
+  block_ptr_->ReleaseShared();
 
   val_ptr_ = nullptr;
   block_ptr_ = nullptr;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-SharedPtr<T>::SharedPtr(const SharedPtr<U>& other)
+SharedPtr<T, Policy>::SharedPtr(const SharedPtr<U, Policy>& other)
 requires(std::is_base_of_v<T, U>):
   val_ptr_(other.val_ptr_),
   block_ptr_(other.block_ptr_) {
   if (block_ptr_) {
-    ++block_ptr_->shared_cnt;
+    block_ptr_->AddShared();
   }
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-SharedPtr<T>::SharedPtr(SharedPtr<U>&& other) noexcept
+SharedPtr<T, Policy>::SharedPtr(SharedPtr<U, Policy>&& other) noexcept
 requires(std::is_base_of_v<T, U>):
   val_ptr_(std::move(other.val_ptr_)),
   block_ptr_(std::move(other.block_ptr_)) {
@@ -207,37 +353,41 @@ requires(std::is_base_of_v<T, U>):
   other.block_ptr_ = nullptr;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename... Args>
-SharedPtr<T>::SharedPtr(Args&&... args) requires(
+SharedPtr<T, Policy>::SharedPtr(Args&&... args) requires(
+  !std::is_array_v<T> &&
   sizeof...(Args) > 0 &&
   (sizeof...(Args) != 1 || !smartptr_traits::is_shared_ptr_v< std::decay_t<typename smartptr_traits::get_type_t<0, Args...>> >)
 ) {
   block_ptr_ = new ControlBlockMakeShared<T>(std::forward<Args>(args)...);
-  ++block_ptr_->shared_cnt;
+  block_ptr_->AddShared();
 
   val_ptr_ = std::launder(
     reinterpret_cast<T*>(static_cast<ControlBlockMakeShared<T>*>(block_ptr_)->storage)
   );
 
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
     val_ptr_->s_val_ptr_ = val_ptr_;
     val_ptr_->s_block_ptr_ = block_ptr_;
   }
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename AllocT, typename... Args>
-SharedPtr<T>::SharedPtr(std::allocator_arg_t, AllocT alloc, Args &&... args) requires(
-  sizeof...(Args) > 0 &&
+SharedPtr<T, Policy>::SharedPtr(std::allocator_arg_t, AllocT alloc, Args &&... args) requires(
+  !std::is_array_v<T> &&
   (sizeof...(Args) != 1 || !smartptr_traits::is_shared_ptr_v< std::decay_t<typename smartptr_traits::get_type_t<0, Args...>> >)
 ) {
-  using BlockMakeSharedAlloc = std::allocator_traits<AllocT>::template rebind_alloc< ControlBlockMakeShared<T, AllocT> >;
+  // allocator may be given for any value type, block keeps it rebound to T
+  using ValueAlloc = std::allocator_traits<AllocT>::template rebind_alloc<T>;
+  using BlockType = ControlBlockMakeShared<T, ValueAlloc>;
+  using BlockMakeSharedAlloc = typename BlockType::ControlBlockSharedAlloc;
+  ValueAlloc value_alloc(alloc);
   BlockMakeSharedAlloc block_alloc(alloc);
-  ControlBlockMakeShared<T, AllocT>* make_shared_block =
-    std::allocator_traits<BlockMakeSharedAlloc>::allocate(block_alloc, 1);
+  BlockType* make_shared_block = std::allocator_traits<BlockMakeSharedAlloc>::allocate(block_alloc, 1);
   try {
-    std::allocator_traits<BlockMakeSharedAlloc>::construct(block_alloc, make_shared_block, std::allocator_arg, alloc,
+    std::allocator_traits<BlockMakeSharedAlloc>::construct(block_alloc, make_shared_block, std::allocator_arg, value_alloc,
                                                            std::forward<Args>(args)...);
   } catch (...) {
     std::allocator_traits<BlockMakeSharedAlloc>::deallocate(block_alloc, make_shared_block, 1);
@@ -245,91 +395,218 @@ SharedPtr<T>::SharedPtr(std::allocator_arg_t, AllocT alloc, Args &&... args) req
   }
 
   block_ptr_ = make_shared_block;
-  ++block_ptr_->shared_cnt;
+  block_ptr_->AddShared();
+  val_ptr_ = std::launder(make_shared_block->val_ptr());
+
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
+    val_ptr_->s_val_ptr_ = val_ptr_;
+    val_ptr_->s_block_ptr_ = block_ptr_;
+  }
+}
+
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(smartptr_traits::for_overwrite_t tag) requires(!std::is_array_v<T>) {
+  block_ptr_ = new ControlBlockMakeShared<T>(tag);
+  block_ptr_->AddShared();
+
   val_ptr_ = std::launder(
     reinterpret_cast<T*>(static_cast<ControlBlockMakeShared<T>*>(block_ptr_)->storage)
   );
 
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
     val_ptr_->s_val_ptr_ = val_ptr_;
     val_ptr_->s_block_ptr_ = block_ptr_;
   }
 }
 
-template<typename T>
+template<typename T, typename Policy>
+template<typename AllocU, typename ConstructElem>
+void SharedPtr<T, Policy>::InitArray(AllocU alloc, size_t n, ConstructElem construct_elem) {
+  using BlockType = ControlBlockMakeSharedArray<AllocU>;
+  using BlockAlloc = typename BlockType::BlockAlloc;
+  BlockAlloc block_alloc(alloc);
+  size_t block_cnt = BlockType::BlockCount(n);
+  BlockType* block = std::allocator_traits<BlockAlloc>::allocate(block_alloc, block_cnt);
+  try {
+    std::allocator_traits<BlockAlloc>::construct(block_alloc, block, alloc);
+  } catch (...) {
+    std::allocator_traits<BlockAlloc>::deallocate(block_alloc, block, block_cnt);
+    throw;
+  }
+
+  typename BlockType::ElemAlloc elem_alloc(alloc);
+  element_type* elems = block->val_ptr();
+  try {
+    for (; block->size < n; ++block->size) {
+      construct_elem(elem_alloc, elems + block->size);
+    }
+  } catch (...) {
+    block->destroy_obj();
+    std::allocator_traits<BlockAlloc>::destroy(block_alloc, block);
+    std::allocator_traits<BlockAlloc>::deallocate(block_alloc, block, block_cnt);
+    throw;
+  }
+
+  block_ptr_ = block;
+  block_ptr_->AddShared();
+  val_ptr_ = elems;
+}
+
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(size_t n) requires(std::is_unbounded_array_v<T>) {
+  InitArray(std::allocator<element_type>(), n, [](auto& elem_alloc, element_type* ptr) {
+    std::allocator_traits<std::remove_reference_t<decltype(elem_alloc)>>::construct(elem_alloc, ptr);
+  });
+}
+
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(size_t n, const element_type& val) requires(std::is_unbounded_array_v<T>) {
+  InitArray(std::allocator<element_type>(), n, [&val](auto& elem_alloc, element_type* ptr) {
+    std::allocator_traits<std::remove_reference_t<decltype(elem_alloc)>>::construct(elem_alloc, ptr, val);
+  });
+}
+
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(smartptr_traits::for_overwrite_t, size_t n) requires(std::is_unbounded_array_v<T>) {
+  InitArray(std::allocator<element_type>(), n, [](auto&, element_type* ptr) {
+    ::new (static_cast<void*>(ptr)) element_type;
+  });
+}
+
+template<typename T, typename Policy>
+template<typename AllocT>
+SharedPtr<T, Policy>::SharedPtr(std::allocator_arg_t, AllocT alloc, size_t n) requires(std::is_unbounded_array_v<T>) {
+  InitArray(alloc, n, [](auto& elem_alloc, element_type* ptr) {
+    std::allocator_traits<std::remove_reference_t<decltype(elem_alloc)>>::construct(elem_alloc, ptr);
+  });
+}
+
+template<typename T, typename Policy>
+template<typename AllocT>
+SharedPtr<T, Policy>::SharedPtr(std::allocator_arg_t, AllocT alloc, size_t n, const element_type& val) requires(std::is_unbounded_array_v<T>) {
+  InitArray(alloc, n, [&val](auto& elem_alloc, element_type* ptr) {
+    std::allocator_traits<std::remove_reference_t<decltype(elem_alloc)>>::construct(elem_alloc, ptr, val);
+  });
+}
+
+template<typename T, typename Policy>
 template<typename U>
-SharedPtr<T>::SharedPtr(const SharedPtr<U> &r, T *ptr) noexcept: SharedPtr(r) {
+SharedPtr<T, Policy>::SharedPtr(const SharedPtr<U, Policy> &r, element_type *ptr) noexcept: SharedPtr(r) {
   val_ptr_ = ptr;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-SharedPtr<T>::SharedPtr(WeakPtr<U> &&other) {
-  if (!other.block_ptr_ || other.block_ptr_->shared_cnt == 0) {
+SharedPtr<T, Policy>::SharedPtr(WeakPtr<U, Policy> &&other) {
+  if (!other.block_ptr_ || !other.block_ptr_->TryAddShared()) {
     throw std::bad_weak_ptr();
   }
   val_ptr_ = std::move(other.val_ptr_);
   block_ptr_ = std::move(other.block_ptr_);
 
-  assert(block_ptr_->weak_cnt && block_ptr_->shared_cnt);
-  ++block_ptr_->shared_cnt;
-  --block_ptr_->weak_cnt;
+  // weak reference of other is dropped, block is still kept by our shared one
+  block_ptr_->ReleaseWeak();
 
   other.val_ptr_ = nullptr;
   other.block_ptr_ = nullptr;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-SharedPtr<T>::SharedPtr(const WeakPtr<U> &other) {
-  if (!other.block_ptr_ || other.block_ptr_->shared_cnt == 0) {
+SharedPtr<T, Policy>::SharedPtr(const WeakPtr<U, Policy> &other) {
+  if (!other.block_ptr_ || !other.block_ptr_->TryAddShared()) {
     throw std::bad_weak_ptr();
   }
   val_ptr_ = other.val_ptr_;
   block_ptr_ = other.block_ptr_;
-
-  ++block_ptr_->shared_cnt;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename AllocU>
 template<typename... Args>
-SharedPtr<T>::ControlBlockMakeShared<U, AllocU>::ControlBlockMakeShared(std::allocator_arg_t, AllocU alloc, Args &&... args):
+SharedPtr<T, Policy>::ControlBlockMakeShared<U, AllocU>::ControlBlockMakeShared(std::allocator_arg_t, AllocU alloc, Args &&... args):
+  BlockBase(&Manage),
   alloc(alloc)
 {
-  std::allocator_traits<AllocU>::construct(alloc, val_ptr(), std::forward<Args>(args)...);
+  std::allocator_traits<AllocU>::construct(this->alloc, val_ptr(), std::forward<Args>(args)...);
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename AllocU>
 template<typename... Args>
-SharedPtr<T>::ControlBlockMakeShared<U, AllocU>::ControlBlockMakeShared(Args &&... args) {
+SharedPtr<T, Policy>::ControlBlockMakeShared<U, AllocU>::ControlBlockMakeShared(Args &&... args): BlockBase(&Manage) {
   std::allocator_traits<AllocU>::construct(alloc, val_ptr(), std::forward<Args>(args)...);
 }
 
-template<typename T>
+template<typename T, typename Policy>
+template<typename U, typename AllocU>
+SharedPtr<T, Policy>::ControlBlockMakeShared<U, AllocU>::ControlBlockMakeShared(smartptr_traits::for_overwrite_t): BlockBase(&Manage) {
+  ::new (static_cast<void*>(&storage)) U;
+}
+
+template<typename T, typename Policy>
+template<typename AllocU>
+void SharedPtr<T, Policy>::ControlBlockMakeSharedArray<AllocU>::destroy_obj() {
+  if constexpr (!std::is_trivially_destructible_v<element_type> || smartptr_traits::has_custom_destroy_v<ElemAlloc, element_type>) {
+    ElemAlloc elem_alloc(alloc);
+    for (size_t i = size; i > 0; --i) {
+      std::allocator_traits<ElemAlloc>::destroy(elem_alloc, val_ptr() + i - 1);
+    }
+  }
+}
+
+template<typename T, typename Policy>
+template<typename AllocU>
+void SharedPtr<T, Policy>::ControlBlockMakeSharedArray<AllocU>::delete_self() {
+  BlockAlloc block_alloc(alloc);
+  size_t block_cnt = BlockCount(size);
+  std::allocator_traits<BlockAlloc>::destroy(block_alloc, this);
+  std::allocator_traits<BlockAlloc>::deallocate(block_alloc, this, block_cnt);
+}
+
+template<typename T, typename Policy>
+template<typename AllocU>
+void SharedPtr<T, Policy>::ControlBlockMakeSharedArray<AllocU>::Manage(BlockBase* block, BlockOp op) {
+  ControlBlockMakeSharedArray* self = static_cast<ControlBlockMakeSharedArray*>(block);
+  if (op != BlockOp::kDeleteSelf) {
+    self->destroy_obj();
+  }
+  if (op != BlockOp::kDestroyObj) {
+    self->delete_self();
+  }
+}
+
+template<typename T, typename Policy>
 template<typename U, typename AllocU>
-void SharedPtr<T>::ControlBlockMakeShared<U, AllocU>::delete_self() {
+void SharedPtr<T, Policy>::ControlBlockMakeShared<U, AllocU>::delete_self() {
   ControlBlockSharedAlloc block_alloc(alloc);
   std::allocator_traits<ControlBlockSharedAlloc>::destroy(block_alloc, this);
   std::allocator_traits<ControlBlockSharedAlloc>::deallocate(block_alloc, this, 1);
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename AllocU>
-void SharedPtr<T>::ControlBlockMakeShared<U, AllocU>::destroy_obj() {
-  std::allocator_traits<AllocU>::destroy(alloc, val_ptr());
+void SharedPtr<T, Policy>::ControlBlockMakeShared<U, AllocU>::destroy_obj() {
+  if constexpr (!std::is_trivially_destructible_v<U> || smartptr_traits::has_custom_destroy_v<AllocU, U>) {
+    std::allocator_traits<AllocU>::destroy(alloc, val_ptr());
+  }
 }
 
-template<typename T>
-template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::~ControlBlockRegular() {
-  deleter(ptr);
+template<typename T, typename Policy>
+template<typename U, typename AllocU>
+void SharedPtr<T, Policy>::ControlBlockMakeShared<U, AllocU>::Manage(BlockBase* block, BlockOp op) {
+  ControlBlockMakeShared* self = static_cast<ControlBlockMakeShared*>(block);
+  if (op != BlockOp::kDeleteSelf) {
+    self->destroy_obj();
+  }
+  if (op != BlockOp::kDestroyObj) {
+    self->delete_self();
+  }
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-auto SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::operator=(ControlBlockRegular other)
+auto SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::operator=(ControlBlockRegular other)
 -> SharedPtr::ControlBlockRegular<U, DeleterU, AllocU>& {
   std::swap(ptr, other.ptr);
   std::swap(alloc, other.alloc);
@@ -337,17 +614,19 @@ auto SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::operator=(ControlBl
   return *this;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(const ControlBlockRegular &other):
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(const ControlBlockRegular &other):
+  BlockBase(&Manage),
   ptr(other.ptr),
   alloc(other.alloc),
   deleter(other.deleter)
 {}
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(ControlBlockRegular &&other) noexcept:
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(ControlBlockRegular &&other) noexcept:
+  BlockBase(&Manage),
   ptr(std::move(other.ptr)),
   alloc(std::move(other.alloc)),
   deleter(std::move(other.deleter))
@@ -355,79 +634,91 @@ SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(Cont
   other.ptr = nullptr;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(AllocU alloc, DeleterU deleter):
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(AllocU alloc, DeleterU deleter):
   ptr(nullptr),
   alloc(alloc),
   deleter(deleter),
-  ControlBlockBase()
+  BlockBase(&Manage)
 {}
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(U* ptr, DeleterU& deleter):
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(U* ptr, DeleterU& deleter):
   ptr(ptr),
   alloc(AllocU{}),
   deleter(deleter),
-  ControlBlockBase()
+  BlockBase(&Manage)
 {}
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(U* ptr, DeleterU& deleter, AllocU& alloc):
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(U* ptr, DeleterU& deleter, AllocU& alloc):
   ptr(ptr),
   alloc(alloc),
   deleter(deleter),
-  ControlBlockBase()
+  BlockBase(&Manage)
 {}
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(DeleterU deleter):
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(DeleterU deleter):
   ptr(nullptr),
   alloc(AllocU{}),
   deleter(deleter),
-  ControlBlockBase()
+  BlockBase(&Manage)
 {}
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(U *ptr):
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular(U *ptr):
   ptr(ptr),
   alloc(AllocU{}),
   deleter(DeleterU{}),
-  ControlBlockBase()
+  BlockBase(&Manage)
 {}
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular():
+SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegular():
   ptr(nullptr),
   alloc(AllocU{}),
   deleter(DeleterU{}),
-  ControlBlockBase()
+  BlockBase(&Manage)
 {}
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-void SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::delete_self() {
+void SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::delete_self() {
   ControlBlockRegularAlloc block_alloc(alloc);
   std::allocator_traits<ControlBlockRegularAlloc>::destroy(block_alloc, this);
   std::allocator_traits<ControlBlockRegularAlloc>::deallocate(block_alloc, this, 1);
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-void SharedPtr<T>::ControlBlockRegular<U, DeleterU, AllocU>::destroy_obj() {
+void SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::destroy_obj() {
   deleter(ptr);
   ptr = nullptr;
 }
 
+template<typename T, typename Policy>
+template<typename U, typename DeleterU, typename AllocU>
+void SharedPtr<T, Policy>::ControlBlockRegular<U, DeleterU, AllocU>::Manage(BlockBase* block, BlockOp op) {
+  ControlBlockRegular* self = static_cast<ControlBlockRegular*>(block);
+  if (op != BlockOp::kDeleteSelf) {
+    self->destroy_obj();
+  }
+  if (op != BlockOp::kDestroyObj) {
+    self->delete_self();
+  }
+}
 
-template<typename T>
+
+template<typename T, typename Policy>
 template<typename U, typename DeleterU, typename AllocU>
-SharedPtr<T>::SharedPtr(U *ptr, DeleterU deleter, AllocU alloc) {
+SharedPtr<T, Policy>::SharedPtr(U *ptr, DeleterU deleter, AllocU alloc) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
   using BlockAlloc = typename ControlBlockRegular<U, DeleterU, AllocU>::ControlBlockRegularAlloc;
   BlockAlloc block_alloc(alloc);
@@ -442,191 +733,174 @@ SharedPtr<T>::SharedPtr(U *ptr, DeleterU deleter, AllocU alloc) {
   val_ptr_ = ptr;
   block_ptr_ = reg_block_ptr;
 
-  ++block_ptr_->shared_cnt;
+  block_ptr_->AddShared();
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U, typename DeleterU>
-SharedPtr<T>::SharedPtr(U *ptr, DeleterU deleter) {
+SharedPtr<T, Policy>::SharedPtr(U *ptr, DeleterU deleter) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
   val_ptr_ = ptr;
   block_ptr_ = new ControlBlockRegular<U, DeleterU>(ptr, deleter);
-  ++block_ptr_->shared_cnt;
+  block_ptr_->AddShared();
 }
 
-template<typename T>
-int32_t SharedPtr<T>::use_count() const {
-  return (block_ptr_ ? block_ptr_->shared_cnt : 0);
+template<typename T, typename Policy>
+int32_t SharedPtr<T, Policy>::use_count() const {
+  return (block_ptr_ ? block_ptr_->SharedCount() : 0);
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-void SharedPtr<T>::reset(U* other_ptr) {
+void SharedPtr<T, Policy>::reset(U* other_ptr) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
   if (block_ptr_) {
-    --block_ptr_->shared_cnt;
+    block_ptr_->ReleaseShared();
   }
-  DeleteObjIfNeeded(*this);
 
   val_ptr_ = other_ptr;
   block_ptr_ = new ControlBlockRegular<U>(other_ptr);
-  ++block_ptr_->shared_cnt;
+  block_ptr_->AddShared();
 }
 
-template<typename T>
-void SharedPtr<T>::SwapSharedPtr(SharedPtr &other) {
+template<typename T, typename Policy>
+void SharedPtr<T, Policy>::SwapSharedPtr(SharedPtr &other) {
   std::swap(val_ptr_, other.val_ptr_);
   std::swap(block_ptr_, other.block_ptr_);
 }
 
-template<typename T>
-SharedPtr<T> &SharedPtr<T>::operator=(SharedPtr other) {
+template<typename T, typename Policy>
+SharedPtr<T, Policy> &SharedPtr<T, Policy>::operator=(SharedPtr other) {
   SwapSharedPtr(other);
   return *this;
 }
 
-template<typename T>
-SharedPtr<T>::SharedPtr(T* ptr): val_ptr_(ptr), block_ptr_(new ControlBlockRegular(ptr)) {
-  ++block_ptr_->shared_cnt;
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(T* ptr): val_ptr_(ptr), block_ptr_(new ControlBlockRegular(ptr)) {
+  block_ptr_->AddShared();
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-SharedPtr<T>::SharedPtr(U* ptr) {
+SharedPtr<T, Policy>::SharedPtr(U* ptr) {
   static_assert(std::is_same_v<T, U> || std::is_base_of_v<T, U>);
 
   val_ptr_ = ptr;
   block_ptr_ = new ControlBlockRegular(ptr);
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
     val_ptr_->s_block_ptr_ = block_ptr_;
     val_ptr_->s_val_ptr_ = val_ptr_;
   }
 
-  ++block_ptr_->shared_cnt;
+  block_ptr_->AddShared();
 }
 
-template<typename Ptr>
-void DeleteObjIfNeeded(const Ptr& ptr) {
-  if (!ptr.block_ptr_) {
-    return;
-  }
-  int32_t shared_cnt = ptr.block_ptr_->shared_cnt;
-  int32_t weak_cnt = ptr.block_ptr_->weak_cnt;
-  if (shared_cnt == 0) {
-    ptr.block_ptr_->destroy_obj();
-  }
-  if (shared_cnt == 0 && weak_cnt == 0) {
-    ptr.block_ptr_->delete_self();
-  }
-}
-
-template<typename T>
-SharedPtr<T>::~SharedPtr() {
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::~SharedPtr() {
   if (block_ptr_) {
-    --block_ptr_->shared_cnt;
+    block_ptr_->ReleaseShared();
   }
-  DeleteObjIfNeeded(*this);
 }
 
-template<typename T>
-SharedPtr<T>::SharedPtr(const SharedPtr &other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(const SharedPtr &other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
   if (block_ptr_) {
-    ++block_ptr_->shared_cnt;
+    block_ptr_->AddShared();
   }
 }
 
-template<typename T>
-SharedPtr<T>::SharedPtr(SharedPtr &&other) noexcept: val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
+template<typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(SharedPtr &&other) noexcept: val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
   other.val_ptr_ = nullptr;
   other.block_ptr_ = nullptr;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 class WeakPtr {
 public:
   WeakPtr() noexcept : val_ptr_(nullptr), block_ptr_(nullptr) {}
   template<typename U>
-  WeakPtr(const SharedPtr<U>& other);
+  WeakPtr(const SharedPtr<U, Policy>& other);
   template<typename U>
-  WeakPtr(SharedPtr<U>&& other);
+  WeakPtr(SharedPtr<U, Policy>&& other);
 
   WeakPtr(const WeakPtr& other);
   WeakPtr(WeakPtr&& other);
 
   template<typename U>
-  WeakPtr(const WeakPtr<U>& other);
+  WeakPtr(const WeakPtr<U, Policy>& other);
   template<typename U>
-  WeakPtr(WeakPtr<U>&& other);
+  WeakPtr(WeakPtr<U, Policy>&& other);
 
   WeakPtr& operator=(WeakPtr other);
   template<typename U>
-  WeakPtr& operator=(const WeakPtr<U>& other);
+  WeakPtr& operator=(const WeakPtr<U, Policy>& other);
   template<typename U>
-  WeakPtr& operator=(WeakPtr<U>&& other);
+  WeakPtr& operator=(WeakPtr<U, Policy>&& other);
 
   bool expired() const;
-  SharedPtr<T> lock() const;
+  SharedPtr<T, Policy> lock() const;
   ~WeakPtr();
 private:
-  T* val_ptr_;
-  ControlBlockBase* block_ptr_;
+  typename SharedPtr<T, Policy>::element_type* val_ptr_;
+  ControlBlockBase<Policy>* block_ptr_;
 
-  template<typename U>
+  template<typename U, typename P>
   friend class SharedPtr;
-
-  template<typename Ptr>
-  friend void DeleteObjIfNeeded(const Ptr& smart_ptr);
 };
 
-template<typename T>
-WeakPtr<T>::~WeakPtr() {
+template<typename T, typename Policy>
+WeakPtr<T, Policy>::~WeakPtr() {
   if (block_ptr_) {
-    --block_ptr_->weak_cnt;
-    DeleteObjIfNeeded(*this);
+    block_ptr_->ReleaseWeak();
   }
 }
 
-template<typename T>
-SharedPtr<T> WeakPtr<T>::lock() const {
-  return (expired() ? SharedPtr<T>(static_cast<T*>(nullptr)) : SharedPtr<T>(*this));
+template<typename T, typename Policy>
+SharedPtr<T, Policy> WeakPtr<T, Policy>::lock() const {
+  // expired() and then copy would race with last owner in other thread
+  SharedPtr<T, Policy> res;
+  if (block_ptr_ && block_ptr_->TryAddShared()) {
+    res.val_ptr_ = val_ptr_;
+    res.block_ptr_ = block_ptr_;
+  }
+  return res;
 }
 
-template<typename T>
-bool WeakPtr<T>::expired() const {
-  return (block_ptr_ ? block_ptr_->shared_cnt == 0 : true);
+template<typename T, typename Policy>
+bool WeakPtr<T, Policy>::expired() const {
+  return (block_ptr_ ? block_ptr_->SharedCount() == 0 : true);
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-auto WeakPtr<T>::operator=(const WeakPtr<U> &other) -> WeakPtr& {
+auto WeakPtr<T, Policy>::operator=(const WeakPtr<U, Policy> &other) -> WeakPtr& {
   if (block_ptr_ == other.block_ptr_) {
     return *this;
   }
   static_assert(std::is_base_of_v<T, U>);
   if (block_ptr_) {
-    --block_ptr_->weak_cnt;
+    block_ptr_->ReleaseWeak();
   }
-  DeleteObjIfNeeded(*this);
 
   val_ptr_ = other.val_ptr_;
   block_ptr_ = other.block_ptr_;
   if (block_ptr_) {
-    ++block_ptr_->weak_cnt;
+    block_ptr_->AddWeak();
   }
   return *this;
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-auto WeakPtr<T>::operator=(WeakPtr<U> &&other) -> WeakPtr& {
+auto WeakPtr<T, Policy>::operator=(WeakPtr<U, Policy> &&other) -> WeakPtr& {
   static_assert(std::is_base_of_v<T, U>);
   if (block_ptr_ == other.block_ptr_) {
     return *this;
   }
   if (block_ptr_) {
-    --block_ptr_->weak_cnt;
+    block_ptr_->ReleaseWeak();
   }
-  DeleteObjIfNeeded(*this);
 
   val_ptr_ = other.val_ptr_;
   block_ptr_ = other.block_ptr_;
@@ -636,65 +910,382 @@ auto WeakPtr<T>::operator=(WeakPtr<U> &&other) -> WeakPtr& {
   return *this;
 }
 
-template<typename T>
-auto WeakPtr<T>::operator=(WeakPtr other) -> WeakPtr& {
+template<typename T, typename Policy>
+auto WeakPtr<T, Policy>::operator=(WeakPtr other) -> WeakPtr& {
   std::swap(val_ptr_, other.val_ptr_);
   std::swap(block_ptr_, other.block_ptr_);
   return *this;
 }
 
-template<typename T>
-WeakPtr<T>::WeakPtr(WeakPtr &&other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
+template<typename T, typename Policy>
+WeakPtr<T, Policy>::WeakPtr(WeakPtr &&other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
   other.val_ptr_ = nullptr;
   other.block_ptr_ = nullptr;
 }
 
-template<typename T>
-WeakPtr<T>::WeakPtr(const WeakPtr &other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
+template<typename T, typename Policy>
+WeakPtr<T, Policy>::WeakPtr(const WeakPtr &other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
   if (block_ptr_) {
-    ++block_ptr_->weak_cnt;
+    block_ptr_->AddWeak();
   }
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-WeakPtr<T>::WeakPtr(SharedPtr<U> &&other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
+WeakPtr<T, Policy>::WeakPtr(SharedPtr<U, Policy> &&other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
   static_assert(std::is_same_v<U, T> || std::is_base_of_v<T, U>);
   if (block_ptr_) {
-    ++block_ptr_->weak_cnt;
+    block_ptr_->AddWeak();
   }
 }
 
-template<typename T>
+template<typename T, typename Policy>
 template<typename U>
-WeakPtr<T>::WeakPtr(const SharedPtr<U> &other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
+WeakPtr<T, Policy>::WeakPtr(const SharedPtr<U, Policy> &other): val_ptr_(other.val_ptr_), block_ptr_(other.block_ptr_) {
   static_assert(std::is_same_v<U, T> || std::is_base_of_v<T, U>);
   if (block_ptr_) {
-    ++block_ptr_->weak_cnt;
+    block_ptr_->AddWeak();
   }
 }
 
-template<typename T>
+template<typename T, typename Policy>
 class EnableSharedFromThis {
 public:
   EnableSharedFromThis() = default;
 
   ~EnableSharedFromThis() = default;
 
-  SharedPtr<T> shared_from_this() const {
-    if (!s_block_ptr_ || s_block_ptr_->shared_cnt == 0) {
+  SharedPtr<T, Policy> shared_from_this() const {
+    if (!s_block_ptr_ || !s_block_ptr_->TryAddShared()) {
       throw std::bad_weak_ptr();
     }
-    return SharedPtr<T>(s_val_ptr_, s_block_ptr_);
+    SharedPtr<T, Policy> res;
+    res.val_ptr_ = s_val_ptr_;
+    res.block_ptr_ = s_block_ptr_;
+    return res;
   }
 private:
-  ControlBlockBase* s_block_ptr_;
-  T* s_val_ptr_;
+  ControlBlockBase<Policy>* s_block_ptr_ = nullptr;
+  T* s_val_ptr_ = nullptr;
 
-  template<class U>
+  template<typename U, typename P>
   friend class SharedPtr;
 };
 
+// Slot for SharedPtr that is read and replaced from many threads without a mutex.
+// Word keeps pointer to Holder in low 48 bits and count of readers that are copying from it in high 16 bits:
+// reader takes a ticket with one fetch_add, copies SharedPtr and gives ticket back.
+// Writer that swaps Holder out moves tickets left in word to Holder counter, last of them deletes Holder.
+template<typename T>
+class AtomicSharedPtr {
+public:
+  using PtrType = SharedPtr<T, AtomicPolicy>;
+
+  AtomicSharedPtr() noexcept: word_(0) {}
+  AtomicSharedPtr(PtrType desired): word_(Pack(MakeHolder(std::move(desired)))) {}
+
+  AtomicSharedPtr(const AtomicSharedPtr& other) = delete;
+  AtomicSharedPtr& operator=(const AtomicSharedPtr& other) = delete;
+
+  bool is_lock_free() const { return word_.is_lock_free(); }
+
+  PtrType load() const;
+  void store(PtrType desired);
+  PtrType exchange(PtrType desired);
+  // as for std::atomic, expected is replaced with current value on failure
+  bool compare_exchange_strong(PtrType& expected, PtrType desired);
+  bool compare_exchange_weak(PtrType& expected, PtrType desired) { return compare_exchange_strong(expected, std::move(desired)); }
+
+  operator PtrType() const { return load(); }
+  AtomicSharedPtr& operator=(PtrType desired);
+
+  ~AtomicSharedPtr();
+private:
+  struct Holder {
+    PtrType ptr;
+    std::atomic<int64_t> cnt;
+
+    explicit Holder(PtrType&& ptr): ptr(std::move(ptr)), cnt(0) {}
+  };
+
+  // user space addresses are assumed to fit in 48 bits, this does not hold with 5-level paging (LA57)
+  // or with tagged pointers (ARM TBI/MTE), MakeHolder checks it for every holder
+  static_assert(sizeof(void*) == 8, "AtomicSharedPtr needs 64-bit pointers whose user space addresses fit in 48 bits");
+  static constexpr uint64_t kTicketShift = 48;
+  static constexpr uint64_t kOneTicket = uint64_t(1) << kTicketShift;
+  static constexpr uint64_t kHolderMask = kOneTicket - 1;
+
+  static uint64_t Pack(Holder* holder) {
+    assert((reinterpret_cast<uint64_t>(holder) & ~kHolderMask) == 0);
+    return reinterpret_cast<uint64_t>(holder);
+  }
+  static Holder* Unpack(uint64_t word) { return reinterpret_cast<Holder*>(word & kHolderMask); }
+  static int64_t Tickets(uint64_t word) { return static_cast<int64_t>(word >> kTicketShift); }
+
+  static Holder* MakeHolder(PtrType&& ptr);
+  static bool Holds(const Holder* holder, const PtrType& ptr);
+  // word was swapped out by this thread, tickets left in it are moved to holder
+  static void Retire(uint64_t word);
+
+  uint64_t AcquireTicket() const;
+  // tickets taken on empty slot are never given back, Pack() drops them
+  void ReleaseTicket(Holder* holder) const;
+
+  mutable std::atomic<uint64_t> word_;
+};
+
+template<typename T>
+typename AtomicSharedPtr<T>::Holder* AtomicSharedPtr<T>::MakeHolder(PtrType&& ptr) {
+  if (ptr.block_ptr_ == nullptr && ptr.val_ptr_ == nullptr) {
+    return nullptr;
+  }
+  Holder* holder = new Holder(std::move(ptr));
+  if ((reinterpret_cast<uint64_t>(holder) & ~kHolderMask) != 0) {
+    // high bits would be overwritten by tickets
+    delete holder;
+    throw std::runtime_error("AtomicSharedPtr: pointer does not fit in 48 bits");
+  }
+  return holder;
+}
+
+template<typename T>
+bool AtomicSharedPtr<T>::Holds(const Holder* holder, const PtrType& ptr) {
+  if (holder == nullptr) {
+    return ptr.block_ptr_ == nullptr && ptr.val_ptr_ == nullptr;
+  }
+  return holder->ptr.block_ptr_ == ptr.block_ptr_ && holder->ptr.val_ptr_ == ptr.val_ptr_;
+}
+
+template<typename T>
+void AtomicSharedPtr<T>::Retire(uint64_t word) {
+  Holder* holder = Unpack(word);
+  if (holder == nullptr) {
+    return;
+  }
+  int64_t tickets = Tickets(word);
+  // readers that failed to give ticket back to word already decremented cnt below zero
+  if (holder->cnt.fetch_add(tickets, std::memory_order_acq_rel) + tickets == 0) {
+    delete holder;
+  }
+}
+
+template<typename T>
+uint64_t AtomicSharedPtr<T>::AcquireTicket() const {
+  return word_.fetch_add(kOneTicket, std::memory_order_acquire) + kOneTicket;
+}
+
+template<typename T>
+void AtomicSharedPtr<T>::ReleaseTicket(Holder* holder) const {
+  if (holder == nullptr) {
+    return;
+  }
+  uint64_t cur = word_.load(std::memory_order_relaxed);
+  // holder is never installed twice, so same pointer means our ticket is still in word
+  while (Unpack(cur) == holder) {
+    if (word_.compare_exchange_weak(cur, cur - kOneTicket, std::memory_order_release, std::memory_order_relaxed)) {
+      return;
+    }
+  }
+  if (holder->cnt.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete holder;
+  }
+}
+
+template<typename T>
+typename AtomicSharedPtr<T>::PtrType AtomicSharedPtr<T>::load() const {
+  Holder* holder = Unpack(AcquireTicket());
+  PtrType res;
+  if (holder != nullptr) {
+    res = holder->ptr;
+  }
+  ReleaseTicket(holder);
+  return res;
+}
+
+template<typename T>
+typename AtomicSharedPtr<T>::PtrType AtomicSharedPtr<T>::exchange(PtrType desired) {
+  uint64_t old = word_.exchange(Pack(MakeHolder(std::move(desired))), std::memory_order_acq_rel);
+  Holder* old_holder = Unpack(old);
+  PtrType res;
+  if (old_holder != nullptr) {
+    res = old_holder->ptr;
+  }
+  Retire(old);
+  return res;
+}
+
+template<typename T>
+void AtomicSharedPtr<T>::store(PtrType desired) {
+  Retire(word_.exchange(Pack(MakeHolder(std::move(desired))), std::memory_order_acq_rel));
+}
+
+template<typename T>
+AtomicSharedPtr<T>& AtomicSharedPtr<T>::operator=(PtrType desired) {
+  store(std::move(desired));
+  return *this;
+}
+
+template<typename T>
+bool AtomicSharedPtr<T>::compare_exchange_strong(PtrType& expected, PtrType desired) {
+  Holder* new_holder = MakeHolder(std::move(desired));
+  while (true) {
+    uint64_t cur = AcquireTicket();
+    Holder* holder = Unpack(cur);
+    if (!Holds(holder, expected)) {
+      expected = (holder != nullptr ? holder->ptr : PtrType());
+      ReleaseTicket(holder);
+      delete new_holder;
+      return false;
+    }
+    while (Unpack(cur) == holder) {
+      if (word_.compare_exchange_weak(cur, Pack(new_holder), std::memory_order_acq_rel, std::memory_order_relaxed)) {
+        // our own ticket is in cur, it is given back by not moving it to holder
+        Retire(cur - kOneTicket);
+        return true;
+      }
+    }
+    // holder was replaced between compare and swap, retry with new one
+    ReleaseTicket(holder);
+  }
+}
+
+template<typename T>
+AtomicSharedPtr<T>::~AtomicSharedPtr() {
+  Retire(word_.load(std::memory_order_acquire));
+}
+
+// Base for objects that keep their own reference count, so IntrusivePtr is one pointer wide
+// and copy touches only the object. Object can make new owning pointer from this at any time.
+template<typename T, typename Policy = SingleThreadPolicy>
+class IntrusiveRefCounted {
+public:
+  using RefCountedBase = IntrusiveRefCounted;
+
+  IntrusivePtr<T> intrusive_from_this() { return IntrusivePtr<T>(static_cast<T*>(this)); }
+  IntrusivePtr<const T> intrusive_from_this() const { return IntrusivePtr<const T>(static_cast<const T*>(this)); }
+
+  int32_t use_count() const { return static_cast<int32_t>(Policy::Load(ref_cnt_)); }
+protected:
+  IntrusiveRefCounted(): ref_cnt_(0) {}
+  // copy of object is new object without owners
+  IntrusiveRefCounted(const IntrusiveRefCounted&): ref_cnt_(0) {}
+  IntrusiveRefCounted& operator=(const IntrusiveRefCounted&) { return *this; }
+
+  ~IntrusiveRefCounted() = default;
+private:
+  mutable typename Policy::CounterType ref_cnt_;
+
+  void AddRef() const { Policy::FetchAdd(ref_cnt_, 1); }
+  // true if it was last reference
+  bool Release() const { return Policy::FetchSub(ref_cnt_, 1) == 1; }
+
+  template<typename U>
+  friend class IntrusivePtr;
+};
+
+template<typename T>
+class IntrusivePtr {
+public:
+  IntrusivePtr() noexcept: ptr_(nullptr) {}
+  explicit IntrusivePtr(T* ptr);
+
+  IntrusivePtr(const IntrusivePtr& other);
+  IntrusivePtr(IntrusivePtr&& other) noexcept;
+
+  template<typename U>
+  IntrusivePtr(const IntrusivePtr<U>& other)
+  requires(std::is_convertible_v<U*, T*>);
+  template<typename U>
+  IntrusivePtr(IntrusivePtr<U>&& other) noexcept
+  requires(std::is_convertible_v<U*, T*>);
+
+  IntrusivePtr& operator=(IntrusivePtr other);
+
+  void reset();
+  void reset(T* ptr);
+
+  T* get() const { return ptr_; }
+  T* operator->() const { return ptr_; }
+  T& operator*() const { return *ptr_; }
+  int32_t use_count() const { return (ptr_ ? ptr_->use_count() : 0); }
+
+  ~IntrusivePtr();
+private:
+  T* ptr_;
+
+  void AddRef();
+  void Release();
+  void SwapWith(IntrusivePtr& other) { std::swap(ptr_, other.ptr_); }
+
+  template<typename U>
+  friend class IntrusivePtr;
+};
+
+template<typename T>
+void IntrusivePtr<T>::AddRef() {
+  if (ptr_) {
+    static_cast<const typename T::RefCountedBase*>(ptr_)->AddRef();
+  }
+}
+
+template<typename T>
+void IntrusivePtr<T>::Release() {
+  if (ptr_ && static_cast<const typename T::RefCountedBase*>(ptr_)->Release()) {
+    delete ptr_;
+  }
+}
+
+template<typename T>
+IntrusivePtr<T>::IntrusivePtr(T* ptr): ptr_(ptr) {
+  AddRef();
+}
+
+template<typename T>
+IntrusivePtr<T>::IntrusivePtr(const IntrusivePtr& other): ptr_(other.ptr_) {
+  AddRef();
+}
+
+template<typename T>
+IntrusivePtr<T>::IntrusivePtr(IntrusivePtr&& other) noexcept: ptr_(other.ptr_) {
+  other.ptr_ = nullptr;
+}
+
+template<typename T>
+template<typename U>
+IntrusivePtr<T>::IntrusivePtr(const IntrusivePtr<U>& other)
+requires(std::is_convertible_v<U*, T*>): ptr_(other.ptr_) {
+  AddRef();
+}
+
+template<typename T>
+template<typename U>
+IntrusivePtr<T>::IntrusivePtr(IntrusivePtr<U>&& other) noexcept
+requires(std::is_convertible_v<U*, T*>): ptr_(other.ptr_) {
+  other.ptr_ = nullptr;
+}
+
+template<typename T>
+IntrusivePtr<T>& IntrusivePtr<T>::operator=(IntrusivePtr other) {
+  SwapWith(other);
+  return *this;
+}
+
+template<typename T>
+void IntrusivePtr<T>::reset() {
+  IntrusivePtr().SwapWith(*this);
+}
+
+template<typename T>
+void IntrusivePtr<T>::reset(T* ptr) {
+  // new object gets its reference before old one can be deleted
+  IntrusivePtr(ptr).SwapWith(*this);
+}
+
+template<typename T>
+IntrusivePtr<T>::~IntrusivePtr() {
+  Release();
+}
+
 namespace smart_ptrs {
   template<typename T, typename... Args>
   SharedPtr<T> makeShared(Args&&... args) {
@@ -703,7 +1294,23 @@ namespace smart_ptrs {
 
   template<typename T, typename Alloc, typename... Args>
   SharedPtr<T> makeShared(std::allocator_arg_t, Alloc alloc, Args&&... args) {
-    return SharedPtr<T>(alloc, std::forward<Args>(args)...);
+    return SharedPtr<T>(std::allocator_arg, alloc, std::forward<Args>(args)...);
+  }
+
+  // blocks of one type are taken from and returned to per-thread free list instead of malloc
+  template<typename T, typename... Args>
+  SharedPtr<T> makeSharedPooled(Args&&... args) {
+    return SharedPtr<T>(std::allocator_arg, TypePoolAllocator<T>(), std::forward<Args>(args)...);
+  }
+
+  template<typename T>
+  SharedPtr<T> makeSharedForOverwrite() requires(!std::is_array_v<T>) {
+    return SharedPtr<T>(smartptr_traits::for_overwrite);
+  }
+
+  template<typename T>
+  SharedPtr<T> makeSharedForOverwrite(size_t n) requires(std::is_unbounded_array_v<T>) {
+    return SharedPtr<T>(smartptr_traits::for_overwrite, n);
   }
 };
 
@@ -0,0 +1,384 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Function.hpp"
+#include "SharedPtr.hpp"
+
+// Fixed set of workers, each with its own task deque. Worker runs newest task of its own deque first,
+// idle worker steals oldest half of another deque in one go.
+// Tasks are MoveOnlyFunction with big enough buffer that typical lambdas are stored without allocation.
+
+class ThreadPool;
+
+namespace thread_pool_detail {
+  struct NoValue {};
+
+  template<typename R>
+  struct TaskState : IntrusiveRefCounted<TaskState<R>, AtomicPolicy> {
+    using ValueType = std::conditional_t<std::is_void_v<R>, NoValue, R>;
+
+    std::atomic<bool> ready{false};
+    std::optional<ValueType> value;
+#ifndef FUNCTION_NO_EXCEPTIONS
+    std::exception_ptr error;
+#endif
+  };
+
+  template<typename R, typename F>
+  void RunAndStore(TaskState<R>& state, F& func) {
+#ifndef FUNCTION_NO_EXCEPTIONS
+    try {
+#endif
+      if constexpr (std::is_void_v<R>) {
+        std::invoke(func);
+        state.value.emplace();
+      } else {
+        state.value.emplace(std::invoke(func));
+      }
+#ifndef FUNCTION_NO_EXCEPTIONS
+    } catch (...) {
+      state.error = std::current_exception();
+    }
+#endif
+    // task still holds state, so waiter can not free it before notify
+    state.ready.store(true, std::memory_order_release);
+    state.ready.notify_all();
+  }
+}
+
+// future-like result of ThreadPool::submit, get() can be called once
+template<typename R>
+class TaskHandle {
+public:
+  TaskHandle() noexcept: pool_(nullptr) {}
+
+  // false for default constructed handle and after get()
+  bool valid() const { return state_.get() != nullptr; }
+  // ready, wait and get require valid handle
+  bool ready() const;
+
+  // worker thread runs other tasks while waiting, so waiting inside pool can not deadlock
+  void wait() const;
+  R get();
+private:
+  using State = thread_pool_detail::TaskState<R>;
+
+  TaskHandle(ThreadPool* pool, IntrusivePtr<State> state): pool_(pool), state_(std::move(state)) {}
+
+  ThreadPool* pool_;
+  IntrusivePtr<State> state_;
+
+  friend class ThreadPool;
+};
+
+class ThreadPool {
+public:
+  // task is 64 bytes: table pointer and buffer
+  static constexpr size_t kTaskBufferSize = 56;
+  using Task = MoveOnlyFunction<void(), kTaskBufferSize>;
+
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+
+  // exception escaping posted task terminates program, use submit to get it in handle
+  template<typename F>
+  void post(F&& func);
+  // tasks are pushed in chunks, one lock per worker deque
+  template<typename Iterator>
+  void post_batch(Iterator first, Iterator last);
+
+  template<typename F>
+  auto submit(F&& func) -> TaskHandle<std::invoke_result_t<std::decay_t<F>&>>;
+
+  // runs one pending task in calling thread, false if there was none
+  bool run_pending_task();
+
+  size_t size() const { return workers_.size(); }
+
+  // remaining tasks are finished before workers stop
+  ~ThreadPool();
+private:
+  struct alignas(64) Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+  struct CurrentWorker {
+    const ThreadPool* pool = nullptr;
+    size_t index = 0;
+  };
+
+  static CurrentWorker& LocalWorker() {
+    thread_local CurrentWorker worker;
+    return worker;
+  }
+
+  bool IsWorkerThread() const { return LocalWorker().pool == this; }
+  // own deque for worker thread, round robin for others
+  size_t PushIndex();
+  void PushChunk(size_t index, std::vector<Task>& chunk);
+  void Notify(size_t cnt);
+
+  bool TryPop(size_t index, Task& task);
+  bool TrySteal(size_t thief, Task& task);
+  bool TryGetTask(Task& task);
+  void WorkerLoop(size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+
+  // tasks pushed and not yet taken, incremented before push so it never goes below zero
+  std::atomic<size_t> pending_{0};
+  std::atomic<size_t> sleepers_{0};
+  std::atomic<size_t> next_queue_{0};
+
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+
+  template<typename R>
+  friend class TaskHandle;
+};
+
+template<typename R>
+bool TaskHandle<R>::ready() const {
+  assert(valid() && "TaskHandle is empty");
+  return state_->ready.load(std::memory_order_acquire);
+}
+
+template<typename R>
+void TaskHandle<R>::wait() const {
+  assert(valid() && "TaskHandle is empty");
+  if (pool_->IsWorkerThread()) {
+    while (!ready()) {
+      if (!pool_->run_pending_task()) {
+        std::this_thread::yield();
+      }
+    }
+    return;
+  }
+  while (!ready()) {
+    state_->ready.wait(false, std::memory_order_acquire);
+  }
+}
+
+template<typename R>
+R TaskHandle<R>::get() {
+  wait();
+  IntrusivePtr<State> state = std::move(state_);
+#ifndef FUNCTION_NO_EXCEPTIONS
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+#endif
+  if constexpr (!std::is_void_v<R>) {
+    return std::move(*state->value);
+  }
+}
+
+inline ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  workers_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  threads_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this, i]() { WorkerLoop(i); });
+  }
+}
+
+inline size_t ThreadPool::PushIndex() {
+  CurrentWorker& current = LocalWorker();
+  if (current.pool == this) {
+    return current.index;
+  }
+  return next_queue_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+}
+
+inline void ThreadPool::Notify(size_t cnt) {
+  // pairs with sleepers_ increment in WorkerLoop: either we see sleeper or it sees pending task
+  if (sleepers_.load() == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(sleep_mutex_);
+  if (cnt == 1) {
+    wake_.notify_one();
+  } else {
+    wake_.notify_all();
+  }
+}
+
+template<typename F>
+void ThreadPool::post(F&& func) {
+  Task task(std::forward<F>(func));
+  pending_.fetch_add(1);
+  Worker& worker = *workers_[PushIndex()];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  Notify(1);
+}
+
+inline void ThreadPool::PushChunk(size_t index, std::vector<Task>& chunk) {
+  Worker& worker = *workers_[index];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  for (Task& task : chunk) {
+    worker.tasks.push_back(std::move(task));
+  }
+  chunk.clear();
+}
+
+template<typename Iterator>
+void ThreadPool::post_batch(Iterator first, Iterator last) {
+  std::vector<Task> tasks;
+  for (; first != last; ++first) {
+    tasks.emplace_back(std::move(*first));
+  }
+  if (tasks.empty()) {
+    return;
+  }
+  size_t total = tasks.size();
+  pending_.fetch_add(total);
+  if (IsWorkerThread()) {
+    // others will steal from our deque
+    PushChunk(LocalWorker().index, tasks);
+    Notify(total);
+    return;
+  }
+  size_t chunk_size = (total + workers_.size() - 1) / workers_.size();
+  std::vector<Task> chunk;
+  chunk.reserve(chunk_size);
+  for (size_t i = 0; i < total; i += chunk_size) {
+    for (size_t j = i; j < std::min(total, i + chunk_size); ++j) {
+      chunk.push_back(std::move(tasks[j]));
+    }
+    PushChunk(PushIndex(), chunk);
+  }
+  Notify(total);
+}
+
+template<typename F>
+auto ThreadPool::submit(F&& func) -> TaskHandle<std::invoke_result_t<std::decay_t<F>&>> {
+  using R = std::invoke_result_t<std::decay_t<F>&>;
+  using State = thread_pool_detail::TaskState<R>;
+  static_assert(!std::is_reference_v<R>, "submit does not support tasks returning references");
+
+  IntrusivePtr<State> state(new State());
+  post([state, func = std::forward<F>(func)]() mutable {
+    thread_pool_detail::RunAndStore(*state, func);
+  });
+  return TaskHandle<R>(this, std::move(state));
+}
+
+inline bool ThreadPool::TryPop(size_t index, Task& task) {
+  Worker& worker = *workers_[index];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.tasks.empty()) {
+    return false;
+  }
+  task = std::move(worker.tasks.back());
+  worker.tasks.pop_back();
+  return true;
+}
+
+inline bool ThreadPool::TrySteal(size_t thief, Task& task) {
+  size_t cnt = workers_.size();
+  // thief == cnt means calling thread is not a worker and has no deque
+  size_t start = (thief == cnt ? next_queue_.load(std::memory_order_relaxed) : thief + 1);
+  std::vector<Task> stolen;
+  for (size_t i = 0; i < cnt; ++i) {
+    size_t victim = (start + i) % cnt;
+    if (victim == thief) {
+      continue;
+    }
+    Worker& worker = *workers_[victim];
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (worker.tasks.empty()) {
+        continue;
+      }
+      task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+      // rest of the oldest half goes to our deque
+      size_t extra = (thief == cnt ? 0 : worker.tasks.size() / 2);
+      for (size_t j = 0; j < extra; ++j) {
+        stolen.push_back(std::move(worker.tasks.front()));
+        worker.tasks.pop_front();
+      }
+    }
+    if (!stolen.empty()) {
+      PushChunk(thief, stolen);
+    }
+    return true;
+  }
+  return false;
+}
+
+inline bool ThreadPool::TryGetTask(Task& task) {
+  if (pending_.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+  size_t index = (IsWorkerThread() ? LocalWorker().index : workers_.size());
+  if ((index != workers_.size() && TryPop(index, task)) || TrySteal(index, task)) {
+    pending_.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+inline bool ThreadPool::run_pending_task() {
+  Task task;
+  if (!TryGetTask(task)) {
+    return false;
+  }
+  task();
+  return true;
+}
+
+inline void ThreadPool::WorkerLoop(size_t index) {
+  LocalWorker() = CurrentWorker{this, index};
+  Task task;
+  while (true) {
+    if (TryGetTask(task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleepers_.fetch_add(1);
+    wake_.wait(lock, [this]() { return stop_ || pending_.load() != 0; });
+    sleepers_.fetch_sub(1);
+    if (stop_ && pending_.load() == 0) {
+      break;
+    }
+  }
+  LocalWorker() = CurrentWorker{};
+}
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
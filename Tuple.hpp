@@ -1,3 +1,7 @@
+#pragma once
+#include <array>
+#include <compare>
+#include <cstddef>
 #include <iostream>
 #include <type_traits>
 #include <utility>
@@ -135,17 +139,6 @@ namespace detail {
     is_tuple_types_convertible_fwb<IsMove, tuple<Tail...>, tuple<UTail...>>
   > {};
 
-  template<typename T, typename... Types>
-  struct tuple_cnt_type_T {};
-  template<typename T>
-  struct tuple_cnt_type_T<T, tuple<>> {
-    static constexpr u_int32_t value = 0;
-  };
-  template<typename T, typename Head, typename... Tail>
-  struct tuple_cnt_type_T<T, tuple<Head, Tail...>> {
-    static constexpr u_int32_t value = (std::is_same_v<std::decay_t<Head>, T> ? 1 : 0) + tuple_cnt_type_T<T, tuple<Tail...>>::value;
-  };
-
   template<typename... Types>
   constexpr bool is_types_copy_constructible_v = is_types_copy_constructible<Types...>::value;
   template<typename... Types>
@@ -178,15 +171,167 @@ namespace detail {
   constexpr bool converting_constructor_third_condition_v = converting_constructor_third_condition<IsMove, F, S>::value;
   template<bool IsMove, typename F, typename S>
   constexpr bool is_tuple_types_convertible_fwb_v = is_tuple_types_convertible_fwb<IsMove, F, S>::value;
+};
+
+// Elements are stored as flat list of base classes, one leaf per element, so nesting adds no padding.
+// Empty non-final element is base of its leaf and takes no space.
+namespace detail {
+  template<size_t I, typename T, bool IsEmpty = std::is_empty_v<T> && !std::is_final_v<T>>
+  struct tuple_leaf {
+    using type = T;
+    static constexpr size_t kIndex = I;
+
+    tuple_leaf() = default;
+    template<typename U>
+    tuple_leaf(std::in_place_t, U&& arg): value_(std::forward<U>(arg)) {}
+
+    T& Get() { return value_; }
+    const T& Get() const { return value_; }
+
+    T value_;
+  };
+
+  template<size_t I, typename T>
+  struct tuple_leaf<I, T, true> : private T {
+    using type = T;
+    static constexpr size_t kIndex = I;
+
+    tuple_leaf() = default;
+    template<typename U>
+    tuple_leaf(std::in_place_t, U&& arg): T(std::forward<U>(arg)) {}
+
+    T& Get() { return *this; }
+    const T& Get() const { return *this; }
+  };
+
+  // references to constructor arguments, I-th one is found by derived to base conversion like leaves
+  // (std::tuple is not used: <tuple> makes std::tie visible through ADL)
+  template<size_t I, typename T>
+  struct arg_leaf {
+    T&& value;
+  };
+  template<typename Seq, typename... Args>
+  struct arg_pack {};
+  template<size_t... Is, typename... Args>
+  struct arg_pack<std::index_sequence<Is...>, Args...> : arg_leaf<Is, Args>... {};
+
+  template<typename... Args>
+  arg_pack<std::index_sequence_for<Args...>, Args...> forward_args(Args&&... args) {
+    return {{std::forward<Args>(args)}...};
+  }
+  template<size_t I, typename T>
+  T&& arg_at(const arg_leaf<I, T>& leaf) { return std::forward<T>(leaf.value); }
+
+  template<size_t I, typename T>
+  struct type_leaf {
+    using type = T;
+  };
+  template<typename Seq, typename... Types>
+  struct type_pack {};
+  template<size_t... Is, typename... Types>
+  struct type_pack<std::index_sequence<Is...>, Types...> : type_leaf<Is, Types>... {};
+
+  template<size_t I, typename T>
+  type_leaf<I, T> type_leaf_at(const type_leaf<I, T>&);
+  template<size_t I, typename... Types>
+  using type_at_t = typename decltype(type_leaf_at<I>(std::declval<type_pack<std::index_sequence_for<Types...>, Types...>>()))::type;
+
+  // marks constructor that takes all elements as one arg_pack
+  struct tuple_args_t {};
+  // marks constructor that takes elements of other tuple one by one
+  struct tuple_other_t {};
+
+  // base order is layout order, element index is kept in leaf
+  template<typename... Leaves>
+  struct tuple_storage : Leaves... {
+    tuple_storage() = default;
+    template<typename Args>
+    tuple_storage(tuple_args_t, const Args& args): Leaves(std::in_place, arg_at<Leaves::kIndex>(args))... {}
+  };
+
+  template<typename Order, typename... Types>
+  struct tuple_storage_for {};
+  template<size_t... Order, typename... Types>
+  struct tuple_storage_for<std::index_sequence<Order...>, Types...> {
+    using type = tuple_storage<tuple_leaf<Order, type_at_t<Order, Types...>>...>;
+  };
+  template<typename Order, typename... Types>
+  using tuple_storage_t = typename tuple_storage_for<Order, Types...>::type;
+
+  // indices sorted by decreasing alignment, empty elements last, equal ones keep declaration order
+  template<typename... Types>
+  struct packed_order {
+    static constexpr std::array<size_t, sizeof...(Types)> Compute() {
+      std::array<size_t, sizeof...(Types)> key = {(std::is_empty_v<tuple_leaf<0, Types>> ? 0 : alignof(tuple_leaf<0, Types>))...};
+      std::array<size_t, sizeof...(Types)> order{};
+      for (size_t i = 0; i < order.size(); ++i) {
+        size_t j = i;
+        for (; j > 0 && key[order[j - 1]] < key[i]; --j) {
+          order[j] = order[j - 1];
+        }
+        order[j] = i;
+      }
+      return order;
+    }
+    template<size_t... Is>
+    static auto Make(std::index_sequence<Is...>) -> std::index_sequence<Compute()[Is]...>;
+
+    using type = decltype(Make(std::index_sequence_for<Types...>()));
+  };
+
+  // leaf is found by derived to base conversion, no recursion over elements
+  template<size_t I, typename T, bool IsEmpty>
+  tuple_leaf<I, T, IsEmpty>& leaf_at(tuple_leaf<I, T, IsEmpty>& leaf) { return leaf; }
+  template<size_t I, typename T, bool IsEmpty>
+  const tuple_leaf<I, T, IsEmpty>& leaf_at(const tuple_leaf<I, T, IsEmpty>& leaf) { return leaf; }
+
   template<typename T, typename Tuple>
-  constexpr u_int32_t tuple_cnt_type_T_v = tuple_cnt_type_T<T, Tuple>::value;
+  struct tuple_type_index {};
+  template<typename T, template<typename...> typename Tup, typename... Types>
+  struct tuple_type_index<T, Tup<Types...>> {
+    static constexpr bool kSame[] = {std::is_same_v<std::remove_reference_t<Types>, T>..., false};
+    static constexpr size_t kCnt = (0 + ... + (std::is_same_v<std::remove_reference_t<Types>, T> ? 1 : 0));
+
+    static constexpr size_t Find() {
+      size_t i = 0;
+      while (i < sizeof...(Types) && !kSame[i]) {
+        ++i;
+      }
+      return i;
+    }
+    static constexpr size_t value = Find();
+  };
+
+  template<typename First, typename Second, size_t... Is>
+  bool tuple_equal(const First& first, const Second& second, std::index_sequence<Is...>) {
+    return ((get<Is>(first) == get<Is>(second)) && ...);
+  }
+
+  template<typename First, typename Second, size_t... Is>
+  std::partial_ordering tuple_compare(const First& first, const Second& second, std::index_sequence<Is...>) {
+    std::partial_ordering res = std::partial_ordering::equivalent;
+    (((res = (get<Is>(first) <=> get<Is>(second))) == std::partial_ordering::equivalent) && ...);
+    return res;
+  }
 };
 
 template<typename Head, typename... Tail>
 class tuple<Head, Tail...> {
 private:
-  Head head_;
-  tuple<Tail...> tail_;
+  using Storage = detail::tuple_storage_t<std::index_sequence_for<Head, Tail...>, Head, Tail...>;
+  static constexpr bool kHasReference = (std::is_reference_v<Head> || ... || std::is_reference_v<Tail>);
+
+  template<typename Other, size_t... Is>
+  tuple(detail::tuple_other_t, Other&& other, std::index_sequence<Is...>)
+    : storage_(detail::tuple_args_t{}, detail::forward_args(get<Is>(std::forward<Other>(other))...))
+  {}
+
+  template<typename Other, size_t... Is>
+  void AssignFrom(Other&& other, std::index_sequence<Is...>) {
+    ((get<Is>(*this) = get<Is>(std::forward<Other>(other))), ...);
+  }
+
+  Storage storage_;
 
 public:
 
@@ -202,8 +347,7 @@ public:
   requires(
     detail::is_types_copy_constructible_v<Head, Tail...>
   )
-    : head_(head),
-      tail_(tail...)
+    : storage_(detail::tuple_args_t{}, detail::forward_args(head, tail...))
   {}
   template<typename UHead, typename... UTail>
   explicit (!detail::is_tuple_types_convertible_v<tuple<Head, Tail...>, tuple<UHead, UTail...>>)
@@ -213,8 +357,7 @@ public:
   detail::is_tuple_types_constructible_v<tuple<Head, Tail...>, tuple<UHead, UTail...>> &&
   detail::is_tuple_sizes_equal_v<tuple<Head, Tail...>, tuple<UHead, UTail...>>
   )
-    : head_(std::forward<UHead>(other_head)),
-      tail_(std::forward<UTail>(other_tail)...)
+    : storage_(detail::tuple_args_t{}, detail::forward_args(std::forward<UHead>(other_head), std::forward<UTail>(other_tail)...))
   {}
 
   template<typename UHead, typename... UTail>
@@ -225,8 +368,7 @@ public:
   detail::constructible_tuple_v<false, tuple<Head, Tail...>, tuple<UHead, UTail...>> &&
   detail::converting_constructor_third_condition_v<false, tuple<Head, Tail...>, tuple<UHead, UTail...>>
   )
-    : head_(std::forward<decltype((other.head_))>(other.head_)),
-      tail_(other.tail_)
+    : tuple(detail::tuple_other_t{}, other, std::index_sequence_for<Head, Tail...>())
   {}
 
   template<typename UHead, typename... UTail>
@@ -237,55 +379,47 @@ public:
   detail::constructible_tuple_v<true, tuple<Head, Tail...>, tuple<UHead, UTail...>> &&
   detail::converting_constructor_third_condition_v<true, tuple<Head, Tail...>, tuple<UHead, UTail...>>
   )
-    : head_(std::move(other.head_)),
-      tail_(std::move(other.tail_))
+    : tuple(detail::tuple_other_t{}, std::move(other), std::index_sequence_for<Head, Tail...>())
   {}
 
   template<typename T1, typename T2>
   tuple(const std::pair<T1, T2>& other):
-    head_(other.first),
-    tail_(other.second)
+    storage_(detail::tuple_args_t{}, detail::forward_args(other.first, other.second))
   {}
 
   template<typename T1, typename T2>
   tuple(std::pair<T1, T2>&& other):
-    head_(std::move(other.first)),
-    tail_(std::move(other.second))
+    storage_(detail::tuple_args_t{}, detail::forward_args(std::move(other.first), std::move(other.second)))
   {}
 
+  // defaulted, so tuple of trivially copyable types is trivially copyable
   tuple(const tuple& other)
-  requires(detail::is_types_copy_constructible_v<Head, Tail...>)
-    : head_(other.head_),
-      tail_(other.tail_)
-  {
-    static_assert(std::is_copy_constructible_v<decltype(head_)>);
-  }
+  requires(detail::is_types_copy_constructible_v<Head, Tail...>) = default;
   tuple(const tuple& other)
   requires(!detail::is_types_copy_constructible_v<Head, Tail...>) = delete;
 
   tuple(tuple&& other)
-  requires(detail::is_types_move_constructible_v<Head, Tail...>)
-    : head_(std::move(other.head_)),
-      tail_(std::move(other.tail_))
-  {
-    static_assert(std::is_move_constructible_v<decltype(head_)>);
-  }
+  requires(detail::is_types_move_constructible_v<Head, Tail...>) = default;
   tuple(tuple&& other)
   requires(!detail::is_types_move_constructible_v<Head, Tail...>) = delete;
 
+  // defaulted without reference elements, so tuple of trivially copyable types is trivially copyable
+  tuple& operator=(const tuple& other)
+  requires(detail::is_types_copy_assignable_v<Head, Tail...> && !kHasReference) = default;
+  // reference elements assign to objects they refer to, as in tie(a, b) = other
   tuple& operator=(const tuple& other)
-  requires(detail::is_types_copy_assignable_v<Head, Tail...>){
-    head_ = other.head_;
-    tail_ = other.tail_;
+  requires(detail::is_types_copy_assignable_v<Head, Tail...> && kHasReference){
+    AssignFrom(other, std::index_sequence_for<Head, Tail...>());
     return *this;
   }
   tuple& operator=(const tuple& other)
   requires(!detail::is_types_copy_assignable_v<Head, Tail...>) = delete;
 
   tuple& operator=(tuple&& other)
-  requires(detail::is_types_move_assignable_v<Head, Tail...>){
-    head_ = std::forward<Head>(get<0>(std::move(other)));
-    tail_ = std::move(other.tail_);
+  requires(detail::is_types_move_assignable_v<Head, Tail...> && !kHasReference) = default;
+  tuple& operator=(tuple&& other)
+  requires(detail::is_types_move_assignable_v<Head, Tail...> && kHasReference){
+    AssignFrom(std::move(other), std::index_sequence_for<Head, Tail...>());
     return *this;
   }
   tuple& operator=(tuple&& other)
@@ -298,8 +432,7 @@ public:
   detail::is_tuple_sizes_equal_v<tuple<Head, Tail...>, tuple<UHead, UTail...>> &&
   detail::is_tuple_types_copy_assignable_universal_v<tuple<Head, Tail...>, tuple<UHead, UTail...>>
   ) {
-    head_ = other.head_;
-    tail_ = other.tail_;
+    AssignFrom(other, std::index_sequence_for<Head, Tail...>());
     return *this;
   }
   template<typename UHead, typename... UTail>
@@ -308,51 +441,20 @@ public:
   detail::is_tuple_sizes_equal_v<tuple<Head, Tail...>, tuple<UHead, UTail...>> &&
   detail::is_tuple_types_move_assignable_universal_v<tuple<Head, Tail...>, tuple<UHead, UTail...>>
   ) {
-    head_ = std::move(other.head_);
-    tail_ = std::move(other.tail_);
+    AssignFrom(std::move(other), std::index_sequence_for<Head, Tail...>());
     return *this;
   }
   bool operator==(const tuple& other) const {
-    if (head_ != other.head_) return false;
-    if constexpr (sizeof...(Tail) > 0) {
-      return (tail_ == other.tail_);
-    } else {
-      return true;
-    }
+    return detail::tuple_equal(*this, other, std::index_sequence_for<Head, Tail...>());
   }
 
-  template<size_t I, typename UHead, typename... UTail>
-  friend decltype(auto) get_impl(const tuple<UHead, UTail...> &tuple);
-  template<size_t I, typename UHead, typename... UTail>
-  friend decltype(auto) get_impl(const tuple<UHead, UTail...> &&tuple);
-  template<size_t I, typename UHead, typename... UTail>
-  friend decltype(auto) get_impl(tuple<UHead, UTail...> &tuple);
-  template<size_t I, typename UHead, typename... UTail>
-  friend decltype(auto) get_impl(tuple<UHead, UTail...> &&tuple);
   template<size_t I, typename Tuple>
   friend decltype(auto) get(Tuple&& t);
 
-  template<typename T, typename Tuple>
-  friend decltype(auto) get(Tuple&& t);
-  template<typename T, typename... UTypes>
-  friend decltype(auto) get_template_impl(const tuple<UTypes...>& t);
-  template<typename T, typename... UTypes>
-  friend decltype(auto) get_template_impl(tuple<UTypes...>& t);
-  template<typename T, typename... UTypes>
-  friend decltype(auto) get_template_impl(const tuple<UTypes...>&& t);
-  template<typename T, typename... UTypes>
-  friend decltype(auto) get_template_impl(tuple<UTypes...>&& t);
-
-
   template<typename... UTypes>
   friend class tuple_traits;
   template<typename... UTypes>
   friend class tuple;
-
-  template<typename FHead, typename... FTail, typename SHead, typename... STail>
-  friend bool operator==(const tuple<FHead, FTail...>& first, const tuple<SHead, STail...>& second);
-  template<typename FHead, typename... FTail, typename SHead, typename... STail>
-  friend std::partial_ordering operator<=>(const tuple<FHead, FTail...>& first, const tuple<SHead, STail...>& second);
 };
 
 template<typename FHead, typename... FTail, typename SHead, typename... STail>
@@ -360,17 +462,9 @@ bool operator==(const tuple<FHead, FTail...>& first, const tuple<SHead, STail...
   if constexpr(sizeof...(FTail) != sizeof...(STail)) {
     return false;
   } else {
-    using firstHeadType = typename std::remove_cvref_t<decltype(first.head_)>;
-    using secondHeadType = typename std::remove_cvref_t<decltype(second.head_)>;
-    static_assert(std::equality_comparable_with<firstHeadType, secondHeadType>);
-    if (first.head_ != second.head_) {
-      return false;
-    }
-    if constexpr (sizeof...(FTail) >= 0) {
-      return first.tail_ == second.tail_;
-    } else {
-      return true;
-    }
+    static_assert((std::equality_comparable_with<std::remove_cvref_t<FHead>, std::remove_cvref_t<SHead>> && ... &&
+      std::equality_comparable_with<std::remove_cvref_t<FTail>, std::remove_cvref_t<STail>>));
+    return detail::tuple_equal(first, second, std::index_sequence_for<FHead, FTail...>());
   }
 }
 
@@ -379,18 +473,9 @@ std::partial_ordering operator<=>(const tuple<FHead, FTail...>& first, const tup
   if constexpr (sizeof...(FTail) != sizeof...(STail)) {
     return std::partial_ordering::unordered;
   } else {
-    using firstHeadType = typename std::remove_cvref_t<decltype(first.head_)>;
-    using secondHeadType = typename std::remove_cvref_t<decltype(second.head_)>;
-    static_assert(std::three_way_comparable_with<firstHeadType, secondHeadType>);
-    std::partial_ordering head_comp = (first.head_ <=> second.head_);
-    if (head_comp != std::partial_ordering::equivalent) {
-      return head_comp;
-    }
-    if constexpr (sizeof...(FTail) > 0) {
-      return first.tail_ <=> second.tail_;
-    } else {
-      return std::partial_ordering::equivalent;
-    }
+    static_assert((std::three_way_comparable_with<std::remove_cvref_t<FHead>, std::remove_cvref_t<SHead>> && ... &&
+      std::three_way_comparable_with<std::remove_cvref_t<FTail>, std::remove_cvref_t<STail>>));
+    return detail::tuple_compare(first, second, std::index_sequence_for<FHead, FTail...>());
   }
 }
 
@@ -408,97 +493,76 @@ tuple(std::pair<T1, T2>&& pair) -> tuple<T1, T2>;
 
 
 
-template<size_t I, typename UHead, typename... UTail>
-decltype(auto) get_impl(const tuple<UHead, UTail...> &tuple) {
-  return get<I - 1>(tuple.tail_);
-}
-template<size_t I, typename UHead, typename... UTail>
-decltype(auto) get_impl(tuple<UHead, UTail...> &&tuple) {
-  return get<I - 1>(std::move(tuple.tail_));
-}
-template<size_t I, typename UHead, typename... UTail>
-decltype(auto) get_impl(tuple<UHead, UTail...> &tuple) {
-  return get<I - 1>(tuple.tail_);
-}
-template<size_t I, typename UHead, typename... UTail>
-decltype(auto) get_impl(const tuple<UHead, UTail...> &&tuple) {
-  return get<I - 1>(std::move(tuple.tail_));
-}
-
 template<size_t I, typename Tuple>
 decltype(auto) get(Tuple&& tuple) {
   constexpr bool is_const = std::is_const_v<std::remove_reference_t<Tuple>>;
   constexpr bool is_lvalue = std::is_lvalue_reference_v<Tuple>;
-  if constexpr (I == 0) {
-    if constexpr (is_const && is_lvalue) {
-      return std::forward<const decltype(tuple.head_)&>(tuple.head_);
-    } else if constexpr (!is_const && is_lvalue){
-      return std::forward<decltype(tuple.head_)&>(tuple.head_);
-    } else if constexpr (is_const && !is_lvalue) {
-      return std::forward<const decltype(tuple.head_)&&>(tuple.head_);
-    } else {
-      static_assert(!is_const && !is_lvalue);
-      return std::forward<decltype(tuple.head_)&&>(tuple.head_);
-    }
+  auto& leaf = detail::leaf_at<I>(tuple.storage_);
+  using T = typename std::remove_cvref_t<decltype(leaf)>::type;
+  if constexpr (is_const && is_lvalue) {
+    return static_cast<const T&>(leaf.Get());
+  } else if constexpr (!is_const && is_lvalue){
+    return static_cast<T&>(leaf.Get());
+  } else if constexpr (is_const && !is_lvalue) {
+    return static_cast<const T&&>(leaf.Get());
   } else {
-    return get_impl<I>(std::forward<Tuple>(tuple));
+    static_assert(!is_const && !is_lvalue);
+    return static_cast<T&&>(leaf.Get());
   }
 }
-template<typename T, typename... Types>
-decltype(auto) get_template_impl(const tuple<Types...>& tuple) {
-  return get<T>(tuple.tail_);
-}
-template<typename T, typename... Types>
-decltype(auto) get_template_impl(tuple<Types...>& tuple) {
-  return get<T>(tuple.tail_);
-}
-template<typename T, typename... Types>
-decltype(auto) get_template_impl(tuple<Types...>&& tuple) {
-  return get<T>(std::move(tuple.tail_));
-}
-template<typename T, typename... Types>
-decltype(auto) get_template_impl(const tuple<Types...>&& tuple) {
-  return get<T>(std::move(tuple.tail_));
-}
 
 template<typename T, typename Tuple>
 decltype(auto) get(Tuple&& tuple) {
-  static_assert(detail::tuple_cnt_type_T_v<T, std::remove_reference_t<Tuple>> == 1);
-  constexpr bool is_const = std::is_const_v<std::remove_reference_t<Tuple>>;
-  constexpr bool is_lvalue = std::is_lvalue_reference_v<Tuple>;
-  if constexpr (std::is_same_v<std::remove_reference_t<decltype(tuple.head_)>, T>) {
-    if constexpr (is_const && is_lvalue) {
-      return std::forward<const decltype(tuple.head_)&>(tuple.head_);
-    } else if constexpr (!is_const && is_lvalue){
-      return std::forward<decltype(tuple.head_)&>(tuple.head_);
-    } else if constexpr (is_const && !is_lvalue) {
-      return std::forward<const decltype(tuple.head_)&&>(tuple.head_);
-    } else {
-      static_assert(!is_const && !is_lvalue);
-      return std::forward<decltype(tuple.head_)&&>(tuple.head_);
-    }
-  } else {
-    return get_template_impl<T>(tuple);
-  }
+  using Index = detail::tuple_type_index<T, std::remove_cvref_t<Tuple>>;
+  static_assert(Index::kCnt == 1);
+  return get<Index::value>(std::forward<Tuple>(tuple));
 }
 
 template<>
 class tuple<> {};
-bool operator==(const tuple<>&, const tuple<>&) { return true; }
-bool operator!=(const tuple<>&, const tuple<>&) { return false; }
-std::partial_ordering operator<=>(const tuple<>&, const tuple<>&) { return std::partial_ordering::equivalent; }
+inline bool operator==(const tuple<>&, const tuple<>&) { return true; }
+inline bool operator!=(const tuple<>&, const tuple<>&) { return false; }
+inline std::partial_ordering operator<=>(const tuple<>&, const tuple<>&) { return std::partial_ordering::equivalent; }
+
+// Same elements and get<I>/get<T> as tuple, but elements are laid out by decreasing alignment
+// so there is padding only at the end. Elements are constructed and destroyed in layout order.
+template<typename... Types>
+class packed_tuple {
+public:
+  packed_tuple()
+  requires(detail::is_types_default_constructible_v<Types...>)
+  = default;
+
+  template<typename... UTypes>
+  requires(
+    sizeof...(UTypes) == sizeof...(Types) && sizeof...(Types) > 0 &&
+    (std::is_constructible_v<Types, UTypes> && ...)
+  )
+  packed_tuple(UTypes&&... args)
+    : storage_(detail::tuple_args_t{}, detail::forward_args(std::forward<UTypes>(args)...))
+  {}
+
+  bool operator==(const packed_tuple& other) const {
+    return detail::tuple_equal(*this, other, std::index_sequence_for<Types...>());
+  }
+private:
+  detail::tuple_storage_t<typename detail::packed_order<Types...>::type, Types...> storage_;
+
+  template<size_t I, typename Tuple>
+  friend decltype(auto) get(Tuple&& t);
+};
 
 template<typename Tuple>
 struct tuple_size {};
 
-template<typename Head, typename... Tail>
-struct tuple_size<tuple<Head, Tail...>> {
-  static constexpr size_t value = 1 + tuple_size<tuple<Tail...>>::value;
+template<typename... Types>
+struct tuple_size<tuple<Types...>> {
+  static constexpr size_t value = sizeof...(Types);
 };
 
-template<>
-struct tuple_size<tuple<>> {
-  static constexpr size_t value = 0;
+template<typename... Types>
+struct tuple_size<packed_tuple<Types...>> {
+  static constexpr size_t value = sizeof...(Types);
 };
 
 
@@ -2,21 +2,90 @@
 #include "List.hpp"
 #include <vector>
 #include <cassert>
+#include <algorithm>
+#include <bit>
+#include <iterator>
 
 // List is bidirectional so it is map in 2 sides
 
-template<typename Key, typename Val, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, Val>>>
+namespace unordered_map_detail {
+  template<typename Key, typename T>
+  struct is_pair_with_key : std::false_type {};
+  template<typename Key, typename K, typename V>
+  struct is_pair_with_key<Key, std::pair<K, V>> : std::is_same<std::remove_const_t<K>, Key> {};
+
+  // emplace arguments from which key can be read without building the node: (key, val) or (pair)
+  template<typename Key, typename... Args>
+  struct is_key_extractable : std::false_type {};
+  template<typename Key, typename K, typename V>
+  struct is_key_extractable<Key, K, V> : std::is_same<std::remove_cvref_t<K>, Key> {};
+  template<typename Key, typename Pair>
+  struct is_key_extractable<Key, Pair> : is_pair_with_key<Key, std::remove_cvref_t<Pair>> {};
+
+  template<typename Key, typename... Args>
+  constexpr bool is_key_extractable_v = is_key_extractable<Key, Args...>::value;
+
+  template<typename T, typename = void>
+  struct is_transparent : std::false_type {};
+  template<typename T>
+  struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
+
+  // lookup by any K is allowed only when both hasher and comparator accept it without conversion to Key
+  template<typename Hash, typename Equal>
+  constexpr bool is_transparent_v = is_transparent<Hash>::value && is_transparent<Equal>::value;
+};
+
+// Bucket policy decides how many buckets table has and maps hash to bucket
+struct PowerOfTwoBucketPolicy {
+  static uint32_t BucketCount(uint32_t min_count) {
+    return std::bit_ceil(std::max<uint32_t>(min_count, 8));
+  }
+  // mask takes only low bits, so identity std::hash of aligned integers must be mixed first
+  static uint32_t Index(std::size_t hash, uint32_t bucket_count) {
+    uint64_t mixed = static_cast<uint64_t>(hash);
+    mixed ^= mixed >> 33;
+    mixed *= 0xff51afd7ed558ccdULL;
+    mixed ^= mixed >> 33;
+    return static_cast<uint32_t>(mixed) & (bucket_count - 1);
+  }
+};
+
+struct PrimeBucketPolicy {
+  static uint32_t BucketCount(uint32_t min_count) {
+    static constexpr uint32_t primes[] = {
+      5, 11, 23, 47, 97, 197, 397, 797, 1597, 3203, 6421, 12853, 25717, 51437, 102877, 205759, 411527,
+      823117, 1646237, 3292489, 6584983, 13169977, 26339969, 52679969, 105359939, 210719881, 421439783,
+      842879579, 1685759167, 3371518343u
+    };
+    for (uint32_t prime : primes) {
+      if (prime >= min_count) {
+        return prime;
+      }
+    }
+    return primes[std::size(primes) - 1];
+  }
+  static uint32_t Index(std::size_t hash, uint32_t bucket_count) {
+    return hash % bucket_count;
+  }
+};
+
+template<typename Key, typename Val, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, Val>>, typename BucketPolicy = PowerOfTwoBucketPolicy>
 class UnorderedMap {
 public:
   using PairType = std::pair<const Key, Val>;
   struct ListNodeType {
     PairType data;
     std::size_t hash;
+
+    template<typename... Args>
+    explicit ListNodeType(std::size_t hash, Args&&... args): data(std::forward<Args>(args)...), hash(hash) {}
   };
 
   using ListType = List<ListNodeType, Alloc>;
   using ListIteratorType = ListType::iterator;
   using ListConstIteratorType = ListType::const_iterator;
+  using NodeType = typename ListType::DefaultNodeType;
+  using NodeAllocTraits = std::allocator_traits<typename ListType::DefaultNodeAlloc>;
 
   struct InfoNode {
     ListIteratorType it;
@@ -77,7 +146,7 @@ private:
   Val& GetOrAdd(K&& key);
 
   void Rehash(uint32_t new_table_size);
-  void CheckRehash();
+  uint32_t BucketIndex(std::size_t hash) const { return BucketPolicy::Index(hash, table_size_); }
 
 public:
   UnorderedMap();
@@ -87,9 +156,9 @@ public:
   UnorderedMap(UnorderedMap&& other);
 
   template<typename OtherAlloc>
-  UnorderedMap(const UnorderedMap<Key, Val, Hash, Equal, OtherAlloc>& other);
+  UnorderedMap(const UnorderedMap<Key, Val, Hash, Equal, OtherAlloc, BucketPolicy>& other);
   template<typename OtherAlloc>
-  UnorderedMap(UnorderedMap<Key, Val, Hash, Equal, OtherAlloc>&& other);
+  UnorderedMap(UnorderedMap<Key, Val, Hash, Equal, OtherAlloc, BucketPolicy>&& other);
 
   UnorderedMap& operator=(const UnorderedMap& other);
   UnorderedMap& operator=(UnorderedMap&& other);
@@ -99,6 +168,10 @@ public:
 
   Val& at(const Key& key);
   const Val& at(const Key& key) const;
+  template<typename K>
+  Val& at(const K& key) requires(unordered_map_detail::is_transparent_v<Hash, Equal>);
+  template<typename K>
+  const Val& at(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>);
 
   uint32_t size() const;
 
@@ -120,8 +193,14 @@ public:
   void erase(iterator cur);
   template<typename InputIt>
   void erase(InputIt start, InputIt end);
+  uint32_t erase(const Key& key);
+  template<typename K>
+  uint32_t erase(const K& key) requires(unordered_map_detail::is_transparent_v<Hash, Equal> && !std::is_convertible_v<const K&, iterator>);
 
   void reserve(uint32_t sz);
+  // destroys all elements but keeps buckets, so refilling map does not rehash
+  void clear();
+  void shrink_to_fit();
 
   double load_factor() const;
   double max_load_factor() const;
@@ -131,33 +210,74 @@ public:
   template<typename... Args>
   std::pair<iterator, bool> emplace(Args&&... args);
 
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(const Key& key, M&& obj);
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(Key&& key, M&& obj);
+
   const_iterator find(const Key &key) const;
   iterator find(const Key &key);
+  template<typename K>
+  const_iterator find(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>);
+  template<typename K>
+  iterator find(const K& key) requires(unordered_map_detail::is_transparent_v<Hash, Equal>);
+
+  bool contains(const Key& key) const;
+  template<typename K>
+  bool contains(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>);
+  uint32_t count(const Key& key) const;
+  template<typename K>
+  uint32_t count(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>);
   void swap(UnorderedMap& other);
 
   ~UnorderedMap() = default;
 private:
   template<typename F>
   std::pair<iterator, bool> insert_helper(F&& cur);
+
+  // hash is computed by caller once per operation, cached node hash rejects most of keys without key_equal_
+  template<typename K>
+  ListIteratorType FindByHash(const K& key, std::size_t hash) const;
+  template<typename K>
+  uint32_t EraseKey(const K& key);
+  void EraseFromBucket(ListIteratorType it_list, InfoNode& info);
+  // bucket iterators of copied map point to nodes of source, they are recomputed from copied list
+  void RebuildBuckets();
+
+  template<typename... Args>
+  NodeType* CreateNode(Args&&... args);
+  void DestroyNode(NodeType* node);
+  // puts created node to its bucket, node is not owned by map if this throws
+  iterator LinkNode(NodeType* node);
+  template<typename... Args>
+  iterator EmplaceNode(std::size_t hash, Args&&... args);
+
+  template<typename K, typename V>
+  static const Key& ExtractKey(const K& key, const V&) { return key; }
+  template<typename P>
+  static const Key& ExtractKey(const P& pair) { return pair.first; }
+
+  template<typename K, typename... Args>
+  std::pair<iterator, bool> TryEmplaceImpl(K&& key, Args&&... args);
+  template<typename K, typename M>
+  std::pair<iterator, bool> InsertOrAssignImpl(K&& key, M&& obj);
   static constexpr int32_t initial_size_ = 5;
 };
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap(const Alloc &alloc): alloc_(alloc), nodes_(alloc), hash_to_node_in_list_(alloc) {
-  hash_to_node_in_list_.resize(initial_size_);
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::UnorderedMap(const Alloc &alloc): alloc_(alloc), nodes_(alloc), hash_to_node_in_list_(alloc) {
+  hash_to_node_in_list_.resize(BucketPolicy::BucketCount(initial_size_));
   table_size_ = hash_to_node_in_list_.size();
   element_cnt_ = 0;
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::CheckRehash() {
-  if (static_cast<double>(element_cnt_) / table_size_ >= max_load_factor_) {
-    Rehash(table_size_ * 2);
-  }
-}
-
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::swap(UnorderedMap &other) {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::swap(UnorderedMap &other) {
   if (this == &other) return;
   using AllocTraits = std::allocator_traits<Alloc>;
   constexpr bool propagate = AllocTraits::propagate_on_container_swap::value;
@@ -179,69 +299,268 @@ void UnorderedMap<Key, Val, Hash, Equal, Alloc>::swap(UnorderedMap &other) {
   other = std::move(tmp);
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<typename... Args>
-std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc>::emplace(Args&&... args) {
-  PairType cur_node{std::forward<Args>(args)...};
-  iterator find_key = find(cur_node.first);
-  if (find_key != end()) {
-    return {find_key, false};
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::emplace(Args&&... args) {
+  if constexpr (unordered_map_detail::is_key_extractable_v<Key, Args...>) {
+    const Key& key = ExtractKey(args...);
+    std::size_t hash = hasher_(key);
+    ListIteratorType find_key = FindByHash(key, hash);
+    if (find_key != nodes_.end()) {
+      return {iterator(find_key), false};
+    }
+    return {EmplaceNode(hash, std::forward<Args>(args)...), true};
+  } else {
+    // key is known only after construction -> build node once and drop it if key exists
+    NodeType* new_node = CreateNode(0, std::forward<Args>(args)...);
+    // hasher and key_equal can throw too, node is not linked until LinkNode succeeds
+    try {
+      std::size_t hash = hasher_(new_node->val.data.first);
+      new_node->val.hash = hash;
+      ListIteratorType find_key = FindByHash(new_node->val.data.first, hash);
+      if (find_key != nodes_.end()) {
+        DestroyNode(new_node);
+        return {iterator(find_key), false};
+      }
+      return {LinkNode(new_node), true};
+    } catch (...) {
+      DestroyNode(new_node);
+      throw;
+    }
   }
-  return insert_helper(std::move(cur_node));
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::max_load_factor(double f) {
-  max_load_factor_ = f;
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename... Args>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::try_emplace(const Key& key, Args&&... args) {
+  return TryEmplaceImpl(key, std::forward<Args>(args)...);
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-double UnorderedMap<Key, Val, Hash, Equal, Alloc>::max_load_factor() const {
-  return max_load_factor_;
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename... Args>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::try_emplace(Key&& key, Args&&... args) {
+  return TryEmplaceImpl(std::move(key), std::forward<Args>(args)...);
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-double UnorderedMap<Key, Val, Hash, Equal, Alloc>::load_factor() const {
-  return static_cast<double>(element_cnt_) / table_size_;
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K, typename... Args>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::TryEmplaceImpl(K&& key, Args&&... args) {
+  std::size_t hash = hasher_(key);
+  ListIteratorType find_key = FindByHash(key, hash);
+  if (find_key != nodes_.end()) {
+    return {iterator(find_key), false};
+  }
+  iterator new_it = EmplaceNode(hash, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+  return {new_it, true};
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::reserve(uint32_t sz) {
-  uint32_t need_size = static_cast<double>(sz) / max_load_factor_ + 2;
-  Rehash(need_size);
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename M>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::insert_or_assign(const Key& key, M&& obj) {
+  return InsertOrAssignImpl(key, std::forward<M>(obj));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename M>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::insert_or_assign(Key&& key, M&& obj) {
+  return InsertOrAssignImpl(std::move(key), std::forward<M>(obj));
 }
 
-template < typename Key, typename Val, typename Hash, typename Equal, typename Alloc > UnorderedMap <Key, Val, Hash, Equal, Alloc>::const_iterator UnorderedMap <Key, Val, Hash, Equal, Alloc>::find(const Key & key) const {
-  uint32_t iterator_idx = hasher_(key) % table_size_;
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K, typename M>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::InsertOrAssignImpl(K&& key, M&& obj) {
+  std::size_t hash = hasher_(key);
+  ListIteratorType find_key = FindByHash(key, hash);
+  if (find_key != nodes_.end()) {
+    find_key->data.second = std::forward<M>(obj);
+    return {iterator(find_key), false};
+  }
+  return {EmplaceNode(hash, std::forward<K>(key), std::forward<M>(obj)), true};
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::ListIteratorType UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::FindByHash(const K& key, std::size_t hash) const {
+  uint32_t iterator_idx = BucketIndex(hash);
   ListIteratorType it = hash_to_node_in_list_[iterator_idx].it;
   uint32_t cur_cnt = hash_to_node_in_list_[iterator_idx].cnt;
-  if (cur_cnt == 0) {
-    return end();
-  }
-  for (int i = 0; i < cur_cnt; ++i, ++it) {
-    if (key_equal_(it -> data.first, key)) {
-      return const_iterator(it);
+  for (uint32_t i = 0; i < cur_cnt; ++i, ++it) {
+    if (it->hash == hash && key_equal_(it->data.first, key)) {
+      return it;
     }
   }
-  return end();
+  return ListIteratorType(const_cast<typename ListType::BaseNodeType*>(&nodes_.fake_node_));
 }
-template <typename Key, typename Val, typename Hash, typename Equal, typename Alloc > UnorderedMap <Key, Val, Hash, Equal, Alloc>::iterator UnorderedMap <Key, Val, Hash, Equal, Alloc>::find(const Key & key) {
-  uint32_t iterator_idx = hasher_(key) % table_size_;
-  ListIteratorType it = hash_to_node_in_list_[iterator_idx].it;
-  uint32_t cur_cnt = hash_to_node_in_list_[iterator_idx].cnt;
-  if (cur_cnt == 0) {
-    return end();
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename... Args>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::NodeType* UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::CreateNode(Args&&... args) {
+  typename ListType::DefaultNodeAlloc node_alloc(nodes_.alloc_);
+  NodeType* new_node = NodeAllocTraits::allocate(node_alloc, 1);
+  try {
+    NodeAllocTraits::construct(node_alloc, new_node, nullptr, nullptr, std::forward<Args>(args)...);
+  } catch (...) {
+    NodeAllocTraits::deallocate(node_alloc, new_node, 1);
+    throw;
   }
-  for (int i = 0; i < cur_cnt; ++i, ++it) {
-    if (key_equal_(it -> data.first, key)) {
-      return iterator(it);
+  return new_node;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::DestroyNode(NodeType* node) {
+  typename ListType::DefaultNodeAlloc node_alloc(nodes_.alloc_);
+  NodeAllocTraits::destroy(node_alloc, node);
+  NodeAllocTraits::deallocate(node_alloc, node, 1);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::LinkNode(NodeType* node) {
+  if (static_cast<double>(element_cnt_ + 1) > max_load_factor_ * table_size_) {
+    Rehash(BucketPolicy::BucketCount(table_size_ * 2));
+  }
+  uint32_t iterator_idx = BucketIndex(node->val.hash);
+  InfoNode& info = hash_to_node_in_list_[iterator_idx];
+
+  typename ListType::BaseNodeType* prev = (info.cnt == 0 ? &nodes_.fake_node_ : info.it.ptr());
+  typename ListType::BaseNodeType* next = prev->next;
+  node->prev = prev;
+  node->next = next;
+  prev->next = static_cast<typename ListType::BaseNodeType*>(node);
+  next->prev = static_cast<typename ListType::BaseNodeType*>(node);
+
+  if (info.cnt == 0) {
+    info.it = ListIteratorType(node);
+  }
+  ++info.cnt;
+  ++element_cnt_;
+  ++nodes_.size_;
+  return iterator(ListIteratorType(node));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename... Args>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::EmplaceNode(std::size_t hash, Args&&... args) {
+  NodeType* new_node = CreateNode(hash, std::forward<Args>(args)...);
+  try {
+    return LinkNode(new_node);
+  } catch (...) {
+    DestroyNode(new_node);
+    throw;
+  }
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::max_load_factor(double f) {
+  max_load_factor_ = f;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+double UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::max_load_factor() const {
+  return max_load_factor_;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+double UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::load_factor() const {
+  return static_cast<double>(element_cnt_) / table_size_;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::reserve(uint32_t sz) {
+  uint32_t need_size = static_cast<double>(sz) / max_load_factor_ + 2;
+  Rehash(BucketPolicy::BucketCount(need_size));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::find(const Key& key) const {
+  return const_iterator(FindByHash(key, hasher_(key)));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::find(const Key& key) {
+  return iterator(FindByHash(key, hasher_(key)));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::find(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>) {
+  return const_iterator(FindByHash(key, hasher_(key)));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::find(const K& key) requires(unordered_map_detail::is_transparent_v<Hash, Equal>) {
+  return iterator(FindByHash(key, hasher_(key)));
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+bool UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::contains(const Key& key) const {
+  return FindByHash(key, hasher_(key)) != nodes_.end();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+bool UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::contains(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>) {
+  return FindByHash(key, hasher_(key)) != nodes_.end();
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+uint32_t UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::count(const Key& key) const {
+  return contains(key) ? 1 : 0;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+uint32_t UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::count(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>) {
+  return contains(key) ? 1 : 0;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+uint32_t UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::erase(const Key& key) {
+  return EraseKey(key);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+uint32_t UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::erase(const K& key) requires(unordered_map_detail::is_transparent_v<Hash, Equal> && !std::is_convertible_v<const K&, iterator>) {
+  return EraseKey(key);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+uint32_t UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::EraseKey(const K& key) {
+  std::size_t hash = hasher_(key);
+  InfoNode& info = hash_to_node_in_list_[BucketIndex(hash)];
+  ListIteratorType it = info.it;
+  for (uint32_t i = 0; i < info.cnt; ++i, ++it) {
+    if (it->hash == hash && key_equal_(it->data.first, key)) {
+      EraseFromBucket(it, info);
+      return 1;
     }
   }
-  return end();
+  return 0;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::clear() {
+  nodes_.DestroyHead(nodes_.fake_node_.prev);
+  nodes_.size_ = 0;
+  std::fill(hash_to_node_in_list_.begin(), hash_to_node_in_list_.end(), InfoNode{nullptr, 0});
+  element_cnt_ = 0;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::shrink_to_fit() {
+  uint32_t need_size = static_cast<double>(element_cnt_) / max_load_factor_ + 2;
+  uint32_t new_table_size = BucketPolicy::BucketCount(need_size);
+  if (new_table_size < table_size_) {
+    Rehash(new_table_size);
+  }
 }
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<typename InputIt>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::erase(InputIt start, InputIt end) {
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::erase(InputIt start, InputIt end) {
   static_assert(std::is_same_v<iterator, InputIt>, "Iterator must point to PairType");
   for (InputIt cur = start; cur != end;) {
     InputIt next = std::next(cur);
@@ -250,35 +569,37 @@ void UnorderedMap<Key, Val, Hash, Equal, Alloc>::erase(InputIt start, InputIt en
   }
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::erase(UnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator cur) {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::erase(iterator cur) {
   ListIteratorType it_list = cur.ptr();
+  EraseFromBucket(it_list, hash_to_node_in_list_[BucketIndex(it_list->hash)]);
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::EraseFromBucket(ListIteratorType it_list, InfoNode& info) {
   ListIteratorType next_it = std::next(it_list);
-  size_t hash = it_list->hash;
 
   typename ListType::BaseNodeType* cur_node = it_list.ptr();
-  typename ListType::BaseNodeType* next = it_list.ptr()->next;
-  typename ListType::BaseNodeType* prev = it_list.ptr()->prev;
+  typename ListType::BaseNodeType* next = cur_node->next;
+  typename ListType::BaseNodeType* prev = cur_node->prev;
   next->prev = prev;
   prev->next = next;
 
-  typename ListType::DefaultNodeAlloc node_alloc(nodes_.alloc_);
-  std::allocator_traits<typename ListType::DefaultNodeAlloc>::destroy(node_alloc, static_cast<ListType::DefaultNodeType*>(cur_node));
-  std::allocator_traits<typename ListType::DefaultNodeAlloc>::deallocate(node_alloc, static_cast<ListType::DefaultNodeType*>(cur_node), 1);
-
+  DestroyNode(static_cast<NodeType*>(cur_node));
   --element_cnt_;
-  --hash_to_node_in_list_[hash % table_size_].cnt;
-  if (hash_to_node_in_list_[hash % table_size_].cnt == 0) {
-    hash_to_node_in_list_[hash % table_size_].it = nullptr;
-  } else if (hash_to_node_in_list_[hash % table_size_].it == it_list) {
-    hash_to_node_in_list_[hash % table_size_].it = next_it;
-  }
+  --nodes_.size_;
 
+  --info.cnt;
+  if (info.cnt == 0) {
+    info.it = nullptr;
+  } else if (info.it == it_list) {
+    info.it = next_it;
+  }
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<typename InputIt>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::insert(InputIt start, InputIt end) {
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::insert(InputIt start, InputIt end) {
   static_assert(std::is_same_v<PairType, typename InputIt::value_type>, "Iterator must point to NodeType");
   for (InputIt cur = start; cur != end;){
     InputIt next = std::next(cur);
@@ -291,110 +612,75 @@ void UnorderedMap<Key, Val, Hash, Equal, Alloc>::insert(InputIt start, InputIt e
   }
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<typename F>
-std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc>::insert_helper(F&& cur) {
-  if (static_cast<double>(element_cnt_ + 1) > max_load_factor_ * table_size_) {
-    Rehash(table_size_ * 2);
-  }
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::insert_helper(F&& cur) {
   std::size_t hash = hasher_(cur.first);
-  uint32_t iterator_idx = hash % table_size_;
-
-  ListIteratorType it = hash_to_node_in_list_[iterator_idx].it;
-  uint32_t cur_cnt = hash_to_node_in_list_[iterator_idx].cnt;
-  if (cur_cnt == 0) {
-    nodes_.emplace_front(std::forward<F>(cur), hash);
-    hash_to_node_in_list_[iterator_idx] = {nodes_.begin(), 1};
-    ++element_cnt_;
-    return {iterator(nodes_.begin()), true};
+  ListIteratorType find_key = FindByHash(cur.first, hash);
+  if (find_key != nodes_.end()) {
+    return {iterator(find_key), false};
   }
-
-  ListIteratorType next = std::next(it);
-  typename ListType::DefaultNodeAlloc node_alloc(nodes_.alloc_);
-  DefaultNode<ListNodeType>* new_node = std::allocator_traits<typename ListType::DefaultNodeAlloc>::allocate(node_alloc, 1);
-  try {
-    std::allocator_traits<typename ListType::DefaultNodeAlloc>::construct(node_alloc, new_node, it.ptr(), next.ptr(), std::forward<F>(cur), hash);
-  } catch (...) {
-    std::allocator_traits<typename ListType::DefaultNodeAlloc>::deallocate(node_alloc, new_node, 1);
-    throw;
-  }
-
-  it.ptr()->next = static_cast<ListType::BaseNodeType*>(new_node);
-  next.ptr()->prev = static_cast<ListType::BaseNodeType*>(new_node);
-
-  ListIteratorType ans = std::next(it);
-  ++element_cnt_;
-  ++hash_to_node_in_list_[iterator_idx].cnt;
-
-  return {ans, true};
+  return {EmplaceNode(hash, std::forward<F>(cur)), true};
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc>::insert(UnorderedMap::PairType &&cur) {
-  iterator find_key = find(cur.first);
-  if (find_key != end()) {
-    return {find_key, false};
-  }
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::insert(UnorderedMap::PairType &&cur) {
   return insert_helper(std::move(cur));
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc>::insert(const UnorderedMap::PairType &cur) {
-  iterator find_key = find(cur.first);
-  if (find_key != end()) {
-    return {find_key, false};
-  }
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+std::pair<typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator, bool> UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::insert(const UnorderedMap::PairType &cur) {
   return insert_helper(cur);
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc>::begin() {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::begin() {
   return UnorderedMap::iterator(nodes_.begin());
 }
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc>::begin() const {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::begin() const {
   return UnorderedMap::const_iterator(nodes_.cbegin());
 }
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc>::cbegin() const {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::cbegin() const {
   return UnorderedMap::const_iterator(nodes_.cbegin());
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc>::end() {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::end() {
   return UnorderedMap::iterator(nodes_.end());
 }
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc>::end() const {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::end() const {
   return UnorderedMap::const_iterator(nodes_.cend());
 }
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc>::cend() const {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::const_iterator UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::cend() const {
   return UnorderedMap::const_iterator(nodes_.cend());
 }
 
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<bool is_const>
-typename UnorderedMap<Key, Val, Hash, Equal, Alloc>::template Iterator<is_const>::reference UnorderedMap<Key, Val, Hash, Equal, Alloc>::Iterator<is_const>::operator*() const {
+typename UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::template Iterator<is_const>::reference UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::Iterator<is_const>::operator*() const {
   return it_->data;
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<bool is_const>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::Iterator<is_const>::pointer UnorderedMap<Key, Val, Hash, Equal, Alloc>::Iterator<is_const>::operator->() const{
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::Iterator<is_const>::pointer UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::Iterator<is_const>::operator->() const{
   return &(it_->data);
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Val, Hash, Equal, Alloc>::Rehash(uint32_t new_table_size) {
-  std::vector<InfoNode, InfoNodeAlloc> new_hash_2_iterator(new_table_size, {nullptr, 0});
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::Rehash(uint32_t new_table_size) {
+  std::vector<InfoNode, InfoNodeAlloc> new_hash_2_iterator(new_table_size, {nullptr, 0}, hash_to_node_in_list_.get_allocator());
   if (element_cnt_ > 0) {
-    ListType new_nodes;
+    ListType new_nodes(nodes_.get_allocator());
     for (typename ListType::iterator it = nodes_.begin(); it != nodes_.end();) {
       typename ListType::iterator next_c = std::next(it);
 
-      uint32_t new_idx = it->hash % new_table_size;
+      uint32_t new_idx = BucketPolicy::Index(it->hash, new_table_size);
       if (new_hash_2_iterator[new_idx].cnt == 0) {
         typename ListType::BaseNodeType *cur_node = it.ptr();
         typename ListType::BaseNodeType *after_cur_node = new_nodes.fake_node_.next;
@@ -433,46 +719,63 @@ void UnorderedMap<Key, Val, Hash, Equal, Alloc>::Rehash(uint32_t new_table_size)
   hash_to_node_in_list_ = std::move(new_hash_2_iterator);
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-uint32_t UnorderedMap<Key, Val, Hash, Equal, Alloc>::size() const {
-  return element_cnt_;
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+void UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::RebuildBuckets() {
+  std::fill(hash_to_node_in_list_.begin(), hash_to_node_in_list_.end(), InfoNode{nullptr, 0});
+  // nodes of one bucket are adjacent in list and bucket head is first of them
+  for (ListIteratorType it = nodes_.begin(); it != nodes_.end(); ++it) {
+    InfoNode& info = hash_to_node_in_list_[BucketPolicy::Index(it->hash, table_size_)];
+    if (info.cnt == 0) {
+      info.it = it;
+    }
+    ++info.cnt;
+  }
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap() {
-  hash_to_node_in_list_.resize(initial_size_);
-  table_size_ = hash_to_node_in_list_.size();
-  element_cnt_ = 0;
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+uint32_t UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::size() const {
+  return element_cnt_;
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap(const UnorderedMap &other):
+// buckets and nodes get copies of one allocator, so stateful allocators like PoolAllocator share one pool
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::UnorderedMap(): UnorderedMap(Alloc()) {}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::UnorderedMap(const UnorderedMap &other):
   hash_to_node_in_list_(other.hash_to_node_in_list_),
   nodes_(other.nodes_),
+  alloc_(nodes_.get_allocator()),
   hasher_(other.hasher_),
   key_equal_(other.key_equal_),
   table_size_(other.table_size_),
   element_cnt_(other.element_cnt_),
   max_load_factor_(other.max_load_factor_)
-{}
+{
+  RebuildBuckets();
+}
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<typename OtherAlloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap(const UnorderedMap<Key, Val, Hash, Equal, OtherAlloc> &other):
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::UnorderedMap(const UnorderedMap<Key, Val, Hash, Equal, OtherAlloc, BucketPolicy> &other):
   hash_to_node_in_list_(other.hash_to_node_in_list_),
   nodes_(other.nodes_),
+  alloc_(nodes_.get_allocator()),
   hasher_(other.hasher_),
   key_equal_(other.key_equal_),
   table_size_(other.table_size_),
   element_cnt_(other.element_cnt_),
   max_load_factor_(other.max_load_factor_)
-{}
+{
+  RebuildBuckets();
+}
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<typename OtherAlloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap(UnorderedMap<Key, Val, Hash, Equal, OtherAlloc> &&other):
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::UnorderedMap(UnorderedMap<Key, Val, Hash, Equal, OtherAlloc, BucketPolicy> &&other):
   hash_to_node_in_list_(std::move(other.hash_to_node_in_list_)),
   nodes_(std::move(other.nodes_)),
+  alloc_(nodes_.get_allocator()),
   hasher_(std::move(other.hasher_)),
   key_equal_(std::move(other.key_equal_)),
   table_size_(other.table_size_),
@@ -480,10 +783,11 @@ UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap(UnorderedMap<Key, Val,
   max_load_factor_(other.max_load_factor_)
 {}
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap(UnorderedMap &&other):
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::UnorderedMap(UnorderedMap &&other):
   hash_to_node_in_list_(std::move(other.hash_to_node_in_list_)),
   nodes_(std::move(other.nodes_)),
+  alloc_(nodes_.get_allocator()),
   hasher_(std::move(other.hasher_)),
   key_equal_(std::move(other.key_equal_)),
   table_size_(other.table_size_),
@@ -492,8 +796,8 @@ UnorderedMap<Key, Val, Hash, Equal, Alloc>::UnorderedMap(UnorderedMap &&other):
 {}
 
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc> &UnorderedMap<Key, Val, Hash, Equal, Alloc>::operator=(const UnorderedMap &other) {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy> &UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::operator=(const UnorderedMap &other) {
   hash_to_node_in_list_ = other.hash_to_node_in_list_;
   nodes_ = other.nodes_;
   hasher_ = other.hasher_;
@@ -501,11 +805,12 @@ UnorderedMap<Key, Val, Hash, Equal, Alloc> &UnorderedMap<Key, Val, Hash, Equal,
   table_size_ = other.table_size_;
   element_cnt_ = other.element_cnt_;
   max_load_factor_ = other.max_load_factor_;
+  RebuildBuckets();
   return *this;
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Val, Hash, Equal, Alloc> &UnorderedMap<Key, Val, Hash, Equal, Alloc>::operator=(UnorderedMap &&other) {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy> &UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::operator=(UnorderedMap &&other) {
   hash_to_node_in_list_ = std::move(other.hash_to_node_in_list_);
   nodes_ = std::move(other.nodes_);
   hasher_ = std::move(other.hasher_);
@@ -516,8 +821,8 @@ UnorderedMap<Key, Val, Hash, Equal, Alloc> &UnorderedMap<Key, Val, Hash, Equal,
   return *this;
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-Val &UnorderedMap<Key, Val, Hash, Equal, Alloc>::at(const Key &key) {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+Val &UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::at(const Key &key) {
   iterator it = find(key);
   if (it == end()) {
     throw std::runtime_error("AT ERROR");
@@ -525,8 +830,28 @@ Val &UnorderedMap<Key, Val, Hash, Equal, Alloc>::at(const Key &key) {
   return it->second;
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-const Val &UnorderedMap<Key, Val, Hash, Equal, Alloc>::at(const Key &key) const {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+const Val &UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::at(const Key &key) const {
+  const_iterator it = find(key);
+  if (it == end()) {
+    throw std::runtime_error("AT ERROR");
+  }
+  return it->second;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+Val& UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::at(const K& key) requires(unordered_map_detail::is_transparent_v<Hash, Equal>) {
+  iterator it = find(key);
+  if (it == end()) {
+    throw std::runtime_error("AT ERROR");
+  }
+  return it->second;
+}
+
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+template<typename K>
+const Val& UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::at(const K& key) const requires(unordered_map_detail::is_transparent_v<Hash, Equal>) {
   const_iterator it = find(key);
   if (it == end()) {
     throw std::runtime_error("AT ERROR");
@@ -534,25 +859,23 @@ const Val &UnorderedMap<Key, Val, Hash, Equal, Alloc>::at(const Key &key) const
   return it->second;
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-Val &UnorderedMap<Key, Val, Hash, Equal, Alloc>::operator[](const Key& key) {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+Val &UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::operator[](const Key& key) {
   return GetOrAdd(key);
 }
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
-Val &UnorderedMap<Key, Val, Hash, Equal, Alloc>::operator[](Key&& key) {
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
+Val &UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::operator[](Key&& key) {
   return GetOrAdd(std::move(key));
 }
 
-template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc>
+template<typename Key, typename Val, typename Hash, typename Equal, typename Alloc, typename BucketPolicy>
 template<typename K>
-Val &UnorderedMap<Key, Val, Hash, Equal, Alloc>::GetOrAdd(K &&key) {
-  iterator cur_it = find(key);
-  if (cur_it != end()) {
-    return cur_it->second;
+Val &UnorderedMap<Key, Val, Hash, Equal, Alloc, BucketPolicy>::GetOrAdd(K &&key) {
+  std::size_t hash = hasher_(key);
+  ListIteratorType cur_it = FindByHash(key, hash);
+  if (cur_it != nodes_.end()) {
+    return cur_it->data.second;
   }
-  PairType cur_val(std::forward<K>(key), Val{});
-  auto ans = insert_helper(std::move(cur_val));
-  cur_it = ans.first;
-  assert(ans.second == true);
-  return cur_it->second;
+  iterator new_it = EmplaceNode(hash, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple());
+  return new_it->second;
 }
@@ -1,9 +1,19 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 template<typename T, typename... Types>
 struct VariantAlternative;
 template<typename... Types>
 class Variant;
+template<typename... Types>
+class PointerVariant;
 
 
 namespace variant_traits {
@@ -66,24 +76,35 @@ namespace variant_traits {
   struct is_variant : std::false_type {};
   template<typename... Types>
   struct is_variant<Variant<Types...>> : std::true_type {};
+  template<typename... Types>
+  struct is_variant<PointerVariant<Types...>> : std::true_type {};
+  template<typename T>
+  struct is_pointer_variant : std::false_type {};
+  template<typename... Types>
+  struct is_pointer_variant<PointerVariant<Types...>> : std::true_type {};
   template<typename T, typename U>
   struct is_type_in_variant {};
-  template<typename T, typename... Types>
-  struct is_type_in_variant<T, Variant<Types...>> : is_type_in_pack<T, Types...> {};
+  template<typename T, template<typename...> typename Var, typename... Types>
+  struct is_type_in_variant<T, Var<Types...>> : is_type_in_pack<T, Types...> {};
   template<typename T, typename U>
   struct get_index_in_variant_by_type {};
-  template<typename T, typename... Types>
-  struct get_index_in_variant_by_type<T, Variant<Types...>> : get_index_by_type<T, Types...> {};
+  template<typename T, template<typename...> typename Var, typename... Types>
+  struct get_index_in_variant_by_type<T, Var<Types...>> : get_index_by_type<T, Types...> {};
   template<typename... Types>
   struct cnt_of_variant_types {};
-  template<typename... Types>
-  struct cnt_of_variant_types<Variant<Types...>> {
+  template<template<typename...> typename Var, typename... Types>
+  struct cnt_of_variant_types<Var<Types...>> {
     static constexpr size_t value = sizeof...(Types);
   };
   template<size_t Idx, typename... Types>
   struct get_type_in_variant_by_index {};
-  template<size_t Idx, typename... Types>
-  struct get_type_in_variant_by_index<Idx, Variant<Types...>> : get_type_by_index<Idx, Types...> {};
+  template<size_t Idx, template<typename...> typename Var, typename... Types>
+  struct get_type_in_variant_by_index<Idx, Var<Types...>> : get_type_by_index<Idx, Types...> {};
+
+  // smallest unsigned type that holds every index and npos == Cnt
+  template<size_t Cnt>
+  using index_type_t = std::conditional_t<(Cnt <= UINT8_MAX), uint8_t,
+                       std::conditional_t<(Cnt <= UINT16_MAX), uint16_t, uint32_t>>;
 
   template<typename... Types>
   constexpr bool is_type_in_pack_v = is_type_in_pack<Types...>::value;
@@ -99,6 +120,8 @@ namespace variant_traits {
   using get_type_by_index_t = typename get_type_by_index<Idx, Types...>::type;
   template<typename T>
   constexpr bool is_variant_v = is_variant<T>::value;
+  template<typename T>
+  constexpr bool is_pointer_variant_v = is_pointer_variant<T>::value;
   template<typename T, typename U>
   constexpr bool is_type_in_variant_v = is_type_in_variant<T, U>::value;
   template<typename T, typename U>
@@ -129,35 +152,21 @@ struct VariantAlternative {
     ptr->active_index_ = type_index;
   }
 
-  void CopyConstruct(const char* val_ptr, size_t idx) {
-    auto* ptr = static_cast<Variant<Types...>*>(this);
-    if (idx != type_index) {
-      return;
-    }
-    auto storage_ptr = std::launder(reinterpret_cast<T*>(ptr->storage_));
-    if (ptr->active_index_ != type_index) {
-      (ptr->VariantAlternative<Types, Types...>::Destroy(), ...);
-      ptr->active_index_ = Variant<Types...>::npos;
-      new(storage_ptr) T(*reinterpret_cast<const T*>(val_ptr));
-      ptr->active_index_ = type_index;
-    } else {
-      *storage_ptr = (*reinterpret_cast<const T*>(val_ptr));
-    }
+  // entries of Variant dispatch tables, storage holds T or is raw memory for constructors
+  static void DestroyAt(char* storage) {
+    std::launder(reinterpret_cast<T*>(storage))->~T();
   }
-  void MoveConstruct(char* val_ptr, size_t idx) {
-    auto* ptr = static_cast<Variant<Types...>*>(this);
-    if (idx != type_index) {
-      return;
-    }
-    auto storage_ptr = std::launder(reinterpret_cast<T*>(ptr->storage_));
-    if (ptr->active_index_ != type_index) {
-      (ptr->VariantAlternative<Types, Types...>::Destroy(), ...);
-      ptr->active_index_ = Variant<Types...>::npos;
-      new(storage_ptr) T(std::move(*reinterpret_cast<T*>(val_ptr)));
-      ptr->active_index_ = type_index;
-    } else {
-      *storage_ptr = std::move(*reinterpret_cast<T*>(val_ptr));
-    }
+  static void CopyConstructAt(char* storage, const char* src) {
+    new (storage) T(*std::launder(reinterpret_cast<const T*>(src)));
+  }
+  static void MoveConstructAt(char* storage, char* src) {
+    new (storage) T(std::move(*std::launder(reinterpret_cast<T*>(src))));
+  }
+  static void CopyAssignAt(char* storage, const char* src) {
+    *std::launder(reinterpret_cast<T*>(storage)) = *std::launder(reinterpret_cast<const T*>(src));
+  }
+  static void MoveAssignAt(char* storage, char* src) {
+    *std::launder(reinterpret_cast<T*>(storage)) = std::move(*std::launder(reinterpret_cast<T*>(src)));
   }
 
   Variant<Types...>& operator=(const T& val) {
@@ -166,14 +175,9 @@ struct VariantAlternative {
     if (ptr->active_index_ == type_index) {
       *storage_ptr = val;
     } else {
-      try {
-        (ptr->VariantAlternative<Types, Types...>::Destroy(), ...);
-        new(storage_ptr) T(val);
-        ptr->active_index_ = type_index;
-      } catch (...) {
-        ptr->active_index_ = Variant<Types...>::npos;
-        throw;
-      }
+      ptr->Reset();
+      new(storage_ptr) T(val);
+      ptr->active_index_ = type_index;
     }
     return *ptr;
   }
@@ -183,14 +187,9 @@ struct VariantAlternative {
     if (ptr->active_index_ == type_index) {
       *storage_ptr = std::move(val);
     } else {
-      try {
-        (ptr->VariantAlternative<Types, Types...>::Destroy(), ...);
-        new(storage_ptr) T(std::move(val));
-        ptr->active_index_ = type_index;
-      } catch (...) {
-        ptr->active_index_ = Variant<Types...>::npos;
-        throw;
-      }
+      ptr->Reset();
+      new(storage_ptr) T(std::move(val));
+      ptr->active_index_ = type_index;
     }
     return *ptr;
   }
@@ -198,25 +197,12 @@ struct VariantAlternative {
   template<typename... Args>
   T& Emplace(Args&&... args) {
     auto* ptr = static_cast<Variant<Types...>*>(this);
-    try {
-      (ptr->VariantAlternative<Types, Types...>::Destroy(), ...);
-      new(std::launder(ptr->storage_)) T(std::forward<Args>(args)...);
-      ptr->active_index_ = type_index;
-    } catch (...) {
-      ptr->active_index_ = Variant<Types...>::npos;
-      throw;
-    }
-    return *std::launder(reinterpret_cast<T*>(ptr->storage_));;
-  }
-
-  void Destroy() {
-    auto* ptr = static_cast<Variant<Types...>*>(this);
-    if (ptr->active_index_ == type_index) {
-      std::launder(reinterpret_cast<T*>(ptr->storage_))->~T();
-    }
+    // variant stays valueless if constructor throws
+    ptr->Reset();
+    new(std::launder(ptr->storage_)) T(std::forward<Args>(args)...);
+    ptr->active_index_ = type_index;
+    return *std::launder(reinterpret_cast<T*>(ptr->storage_));
   }
-
-  ~VariantAlternative() {}
 };
 
 namespace variant {
@@ -224,17 +210,22 @@ namespace variant {
   bool holds_alternative(const Variant<Types...>& v) {
     return (v.index() == variant_traits::get_index_by_type_v<T, Types...>);
   }
+  template<typename T, typename... Types>
+  bool holds_alternative(const PointerVariant<Types...>& v) {
+    return (v.index() == variant_traits::get_index_by_type_v<T, Types...>);
+  }
 
-  template<typename T, typename Var>
-  decltype(auto) get(Var&& v)
-    requires(variant_traits::is_variant_v<std::remove_cvref_t<Var>> &&
-    variant_traits::is_type_in_variant_v<T, std::remove_cvref_t<Var>>)
+  // no check of active index, caller knows that Idx is active
+  template<size_t Idx, typename Var>
+  decltype(auto) get_unchecked(Var&& v)
+  requires(variant_traits::is_variant_v<std::remove_cvref_t<Var>> &&
+           Idx < variant_traits::cnt_of_variant_types_v<Var>)
   {
-    if (v.index() != variant_traits::get_index_in_variant_by_type_v<T, std::remove_cvref_t<Var>>) {
-      throw std::runtime_error("Index is not active");
-    }
-
-    if constexpr (std::is_const_v<std::remove_reference_t<Var>>) {
+    using T = variant_traits::get_type_in_variant_by_index_t<Idx, Var>;
+    if constexpr (variant_traits::is_pointer_variant_v<std::remove_cvref_t<Var>>) {
+      // pointer is stored with tag bits, so it is returned by value
+      return reinterpret_cast<T>(v.bits_ & ~std::remove_cvref_t<Var>::kTagMask);
+    } else if constexpr (std::is_const_v<std::remove_reference_t<Var>>) {
       auto* storage_ptr = std::launder(reinterpret_cast<const T*>(v.storage_));
       if constexpr (std::is_lvalue_reference_v<Var>) {
         return *storage_ptr;
@@ -250,6 +241,18 @@ namespace variant {
       }
     }
   }
+
+  template<typename T, typename Var>
+  decltype(auto) get(Var&& v)
+    requires(variant_traits::is_variant_v<std::remove_cvref_t<Var>> &&
+    variant_traits::is_type_in_variant_v<T, std::remove_cvref_t<Var>>)
+  {
+    constexpr size_t idx = variant_traits::get_index_in_variant_by_type_v<T, std::remove_cvref_t<Var>>;
+    if (v.index() != idx) {
+      throw std::runtime_error("Index is not active");
+    }
+    return variant::get_unchecked<idx>(std::forward<Var>(v));
+  }
   template<size_t Idx, typename Var>
   decltype(auto) get(Var&& v)
   requires(variant_traits::is_variant_v<std::remove_cvref_t<Var>> &&
@@ -258,22 +261,7 @@ namespace variant {
     if (v.index() != Idx) {
       throw std::runtime_error("Index is not active");
     }
-    using T = variant_traits::get_type_in_variant_by_index_t<Idx, Var>;
-    if constexpr (std::is_const_v<std::remove_reference_t<Var>>) {
-      auto* storage_ptr = std::launder(reinterpret_cast<const T*>(v.storage_));
-      if constexpr (std::is_lvalue_reference_v<Var>) {
-        return *storage_ptr;
-      } else {
-        return std::move(*storage_ptr);
-      }
-    } else {
-      auto* storage_ptr = std::launder(reinterpret_cast<T*>(v.storage_));
-      if constexpr (std::is_lvalue_reference_v<Var>) {
-        return *storage_ptr;
-      } else {
-        return std::move(*storage_ptr);
-      }
-    }
+    return variant::get_unchecked<Idx>(std::forward<Var>(v));
   }
 
   template<typename Var, typename... Vars>
@@ -321,44 +309,89 @@ namespace variant {
   requires ((variant_traits::is_variant_v<std::remove_cvref_t<Vars>> && ...))
   using compute_visit_return_t = compute_visit_return<Visitor, std::tuple<>, Vars...>::type;
 
-  template<typename Return, size_t I, typename Visitor, typename Var1, typename... Tail>
-  Return visit_impl(Visitor&& visitor, Var1&& var1, Tail&&... tail) {
-    using Var1Type = std::remove_cvref_t<Var1>;
-    if constexpr (I < variant_traits::cnt_of_variant_types_v<Var1Type>) {
-      if (I == var1.index()) {
-        if constexpr (sizeof...(Tail) == 0) {
-          return std::forward<Visitor>(visitor)(variant::get<I>(std::forward<Var1>(var1)));
-        } else {
-          auto&& extracted = variant::get<I>(std::forward<Var1>(var1));
-
-          auto new_visitor = [&extracted, &visitor](auto&&... rest_args) -> auto {
-            return std::forward<Visitor>(visitor)(
-              std::forward<decltype(extracted)>(extracted),
-              std::forward<decltype(rest_args)>(rest_args)...
-              );
-          };
-
-          return visit_impl<Return, 0>(std::move(new_visitor), std::forward<Tail>(tail)...);
-        }
-      } else {
-        return visit_impl<Return, I + 1>(
-          std::forward<Visitor>(visitor),
-          std::forward<Var1>(var1),
-          std::forward<Tail>(tail)...
-          );
+  // one function per combination of active indices, flattened row-major into one array:
+  // visit is a single indexed indirect call for any number of variants
+  template<typename Return, typename Visitor, typename... Vars>
+  struct visit_table {
+    using fn_t = Return(*)(Visitor&&, Vars&&...);
+
+    static constexpr size_t cnt_of_vars = sizeof...(Vars);
+    static constexpr size_t sizes[] = {variant_traits::cnt_of_variant_types_v<Vars>...};
+    static constexpr size_t total = (variant_traits::cnt_of_variant_types_v<Vars> * ...);
+
+    template<size_t... Is>
+    static Return Call(Visitor&& visitor, Vars&&... vars) {
+      return std::forward<Visitor>(visitor)(variant::get_unchecked<Is>(std::forward<Vars>(vars))...);
+    }
+
+    // index of Pos-th variant encoded in Flat
+    template<size_t Flat, size_t Pos>
+    static constexpr size_t Decode() {
+      size_t div = 1;
+      for (size_t p = Pos + 1; p < cnt_of_vars; ++p) {
+        div *= sizes[p];
       }
+      return Flat / div % sizes[Pos];
+    }
+
+    template<size_t Flat, size_t... Pos>
+    static constexpr fn_t MakeEntry(std::index_sequence<Pos...>) {
+      return &visit_table::Call<Decode<Flat, Pos>()...>;
+    }
+
+    template<size_t... Flat>
+    static constexpr std::array<fn_t, total> MakeTable(std::index_sequence<Flat...>) {
+      return {MakeEntry<Flat>(std::make_index_sequence<cnt_of_vars>())...};
+    }
+
+    static constexpr std::array<fn_t, total> table = MakeTable(std::make_index_sequence<total>());
+  };
+
+  // switch lets compiler inline visitor for small variants
+  static constexpr size_t visit_switch_max = 8;
+
+  template<typename Return, size_t I, typename Visitor, typename Var>
+  Return visit_case(Visitor&& visitor, Var&& var) {
+    if constexpr (I < variant_traits::cnt_of_variant_types_v<Var>) {
+      return std::forward<Visitor>(visitor)(variant::get_unchecked<I>(std::forward<Var>(var)));
     } else {
       throw std::runtime_error("Error in visit");
     }
   }
 
+  template<typename Return, typename Visitor, typename Var>
+  Return visit_switch(Visitor&& visitor, Var&& var) {
+    switch (var.index()) {
+      case 0: return visit_case<Return, 0>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      case 1: return visit_case<Return, 1>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      case 2: return visit_case<Return, 2>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      case 3: return visit_case<Return, 3>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      case 4: return visit_case<Return, 4>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      case 5: return visit_case<Return, 5>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      case 6: return visit_case<Return, 6>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      case 7: return visit_case<Return, 7>(std::forward<Visitor>(visitor), std::forward<Var>(var));
+      default: throw std::runtime_error("Error in visit");
+    }
+  }
+
+  template<typename Return, typename Visitor, typename... Vars>
+  Return visit_impl(Visitor&& visitor, Vars&&... vars) {
+    if constexpr (sizeof...(Vars) == 1 &&
+                  (variant_traits::cnt_of_variant_types_v<Vars> + ...) <= visit_switch_max) {
+      return visit_switch<Return>(std::forward<Visitor>(visitor), std::forward<Vars>(vars)...);
+    } else {
+      size_t flat = 0;
+      ((flat = flat * variant_traits::cnt_of_variant_types_v<Vars> + vars.index()), ...);
+      return visit_table<Return, Visitor, Vars...>::table[flat](std::forward<Visitor>(visitor), std::forward<Vars>(vars)...);
+    }
+  }
 
   template<typename Visitor, typename... Vars>
   auto visit(Visitor&& visitor, Vars&&... vars)
   {
     throw_if_valueless(vars...);
     using Return = typename variant::compute_visit_return_t<Visitor, Vars...>;
-    return variant::visit_impl<Return, 0, Visitor, Vars...>(std::forward<Visitor>(visitor), std::forward<Vars>(vars)...);
+    return variant::visit_impl<Return>(std::forward<Visitor>(visitor), std::forward<Vars>(vars)...);
   }
 }
 
@@ -366,17 +399,22 @@ template<typename... Types>
 class Variant : private VariantAlternative<Types, Types...>... {
 private:
   static constexpr size_t npos = sizeof...(Types);
+  static constexpr bool kTriviallyDestructible = (std::is_trivially_destructible_v<Types> && ...);
+  static constexpr bool kTriviallyCopyConstructible =
+    kTriviallyDestructible && (std::is_trivially_copy_constructible_v<Types> && ...);
+  static constexpr bool kTriviallyMoveConstructible =
+    kTriviallyDestructible && (std::is_trivially_move_constructible_v<Types> && ...);
+  static constexpr bool kTriviallyCopyAssignable =
+    kTriviallyCopyConstructible && (std::is_trivially_copy_assignable_v<Types> && ...);
+  static constexpr bool kTriviallyMoveAssignable =
+    kTriviallyMoveConstructible && (std::is_trivially_move_assignable_v<Types> && ...);
   alignas(variant_traits::max_type_align_v<Types...>) char storage_[variant_traits::max_type_sizeof_v<Types...>];
-  size_t active_index_;
+  variant_traits::index_type_t<sizeof...(Types)> active_index_;
 public:
   template<typename U, typename... UTypes>
   friend class VariantAlternative;
-  template<typename T, typename Var>
-  friend decltype(auto) variant::get(Var&& v)
-  requires(variant_traits::is_variant_v<std::remove_cvref_t<Var>> &&
-           variant_traits::is_type_in_variant_v<T, std::remove_cvref_t<Var>>);
   template<size_t Idx, typename Var>
-  friend decltype(auto) variant::get(Var&& v)
+  friend decltype(auto) variant::get_unchecked(Var&& v)
   requires(variant_traits::is_variant_v<std::remove_cvref_t<Var>> &&
            Idx < variant_traits::cnt_of_variant_types_v<Var>);
 
@@ -384,37 +422,21 @@ public:
   using VariantAlternative<Types, Types...>::operator=...;
   Variant(): Variant(variant_traits::get_type_by_index_t<0, Types...>{}) {}
 
-  Variant(const Variant& other) {
-    active_index_ = Variant::npos;
-    (VariantAlternative<Types, Types...>::CopyConstruct(other.storage_, other.active_index_), ...);
-    active_index_ = other.active_index_;
-
-  }
-  Variant(Variant&& other) {
-    active_index_ = Variant::npos;
-    (VariantAlternative<Types, Types...>::MoveConstruct(other.storage_, other.active_index_), ...);
-    active_index_ = other.active_index_;
-    other.active_index_ = Variant<Types...>::npos;
-  }
-
-  Variant& operator=(const Variant& other) {
-    if (&other == this) {
-      return *this;
-    }
-    (VariantAlternative<Types, Types...>::CopyConstruct(other.storage_, other.active_index_), ...);
-    active_index_ = other.active_index_;
-    return *this;
-  }
-  Variant& operator=(Variant&& other) {
-    if (&other == this) {
-      return *this;
-    }
-    (VariantAlternative<Types, Types...>::MoveConstruct(other.storage_, other.active_index_), ...);
-    active_index_ = other.active_index_;
-
-    other.active_index_ = Variant<Types...>::npos;
-    return *this;
-  }
+  // special members are trivial when they are trivial for every alternative,
+  // otherwise they make one indexed call instead of checking every alternative
+  Variant(const Variant& other)
+  requires(kTriviallyCopyConstructible) = default;
+  Variant(const Variant& other);
+  Variant(Variant&& other)
+  requires(kTriviallyMoveConstructible) = default;
+  Variant(Variant&& other) noexcept((std::is_nothrow_move_constructible_v<Types> && ...));
+
+  Variant& operator=(const Variant& other)
+  requires(kTriviallyCopyAssignable) = default;
+  Variant& operator=(const Variant& other);
+  Variant& operator=(Variant&& other)
+  requires(kTriviallyMoveAssignable) = default;
+  Variant& operator=(Variant&& other);
 
   template<size_t I, typename... Args>
   auto emplace(Args&&... args) -> variant_traits::get_type_by_index_t<I, Types...>& {
@@ -431,8 +453,120 @@ public:
     return (active_index_ == npos);
   }
 
+  ~Variant()
+  requires(kTriviallyDestructible) = default;
   ~Variant() {
-    (VariantAlternative<Types, Types...>::Destroy(), ...);
+    Reset();
   }
+private:
+  // destroys active alternative and leaves variant valueless
+  void Reset();
 };
 
+template<typename... Types>
+void Variant<Types...>::Reset() {
+  if constexpr (!kTriviallyDestructible) {
+    static constexpr void (*destroy[])(char*) = {&VariantAlternative<Types, Types...>::DestroyAt...};
+    if (active_index_ != npos) {
+      destroy[active_index_](storage_);
+    }
+  }
+  active_index_ = npos;
+}
+
+template<typename... Types>
+Variant<Types...>::Variant(const Variant& other): active_index_(npos) {
+  static constexpr void (*copy[])(char*, const char*) = {&VariantAlternative<Types, Types...>::CopyConstructAt...};
+  if (other.active_index_ != npos) {
+    copy[other.active_index_](storage_, other.storage_);
+    active_index_ = other.active_index_;
+  }
+}
+
+template<typename... Types>
+Variant<Types...>::Variant(Variant&& other) noexcept((std::is_nothrow_move_constructible_v<Types> && ...)):
+  active_index_(npos) {
+  static constexpr void (*move[])(char*, char*) = {&VariantAlternative<Types, Types...>::MoveConstructAt...};
+  if (other.active_index_ != npos) {
+    move[other.active_index_](storage_, other.storage_);
+    active_index_ = other.active_index_;
+  }
+}
+
+template<typename... Types>
+Variant<Types...>& Variant<Types...>::operator=(const Variant& other) {
+  if (&other == this) {
+    return *this;
+  }
+  if (other.active_index_ == npos) {
+    Reset();
+  } else if (other.active_index_ == active_index_) {
+    static constexpr void (*assign[])(char*, const char*) = {&VariantAlternative<Types, Types...>::CopyAssignAt...};
+    assign[active_index_](storage_, other.storage_);
+  } else {
+    static constexpr void (*copy[])(char*, const char*) = {&VariantAlternative<Types, Types...>::CopyConstructAt...};
+    Reset();
+    copy[other.active_index_](storage_, other.storage_);
+    active_index_ = other.active_index_;
+  }
+  return *this;
+}
+
+template<typename... Types>
+Variant<Types...>& Variant<Types...>::operator=(Variant&& other) {
+  if (&other == this) {
+    return *this;
+  }
+  if (other.active_index_ == npos) {
+    Reset();
+  } else if (other.active_index_ == active_index_) {
+    static constexpr void (*assign[])(char*, char*) = {&VariantAlternative<Types, Types...>::MoveAssignAt...};
+    assign[active_index_](storage_, other.storage_);
+  } else {
+    static constexpr void (*move[])(char*, char*) = {&VariantAlternative<Types, Types...>::MoveConstructAt...};
+    Reset();
+    move[other.active_index_](storage_, other.storage_);
+    active_index_ = other.active_index_;
+  }
+  return *this;
+}
+
+// Niche packed variant of object pointers: index is kept in low bits that alignment of pointees leaves zero,
+// so whole variant is one pointer. It is never valueless, get returns pointer by value.
+template<typename... Types>
+class PointerVariant {
+private:
+  static constexpr size_t kTagBits = std::bit_width(sizeof...(Types) - 1);
+  static constexpr uintptr_t kTagMask = (uintptr_t(1) << kTagBits) - 1;
+
+  static_assert((std::is_pointer_v<Types> && ...), "PointerVariant alternatives must be pointers");
+  static_assert(((alignof(std::remove_pointer_t<Types>) > kTagMask) && ...),
+                "alignment of pointees leaves no room for index");
+
+  uintptr_t bits_;
+public:
+  template<size_t Idx, typename Var>
+  friend decltype(auto) variant::get_unchecked(Var&& v)
+  requires(variant_traits::is_variant_v<std::remove_cvref_t<Var>> &&
+           Idx < variant_traits::cnt_of_variant_types_v<Var>);
+
+  PointerVariant(): PointerVariant(variant_traits::get_type_by_index_t<0, Types...>{}) {}
+
+  template<typename T>
+  requires(variant_traits::is_type_in_pack_v<T, Types...>)
+  PointerVariant(T ptr): bits_(reinterpret_cast<uintptr_t>(ptr) | variant_traits::get_index_by_type_v<T, Types...>) {}
+
+  template<typename T>
+  requires(variant_traits::is_type_in_pack_v<T, Types...>)
+  PointerVariant& operator=(T ptr) {
+    bits_ = reinterpret_cast<uintptr_t>(ptr) | variant_traits::get_index_by_type_v<T, Types...>;
+    return *this;
+  }
+
+  size_t index() const {
+    return bits_ & kTagMask;
+  }
+  bool valueless_by_exception() const {
+    return false;
+  }
+};
@@ -0,0 +1,251 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "Variant.hpp"
+
+// Structure of arrays for variant values: one dense vector per alternative plus compact tag stream.
+// Every element takes real size of its alternative, visit_all walks each column in a tight loop.
+// Position of element inside its column is found from per-block column counts and a scan of at most
+// kRankBlock - 1 tags, so index costs sizeof...(Types) * 4 / kRankBlock bytes per element.
+template<typename... Types>
+class VariantVector {
+public:
+  using IndexType = variant_traits::index_type_t<sizeof...(Types)>;
+
+  VariantVector() = default;
+
+  size_t size() const { return tags_.size(); }
+  bool empty() const { return tags_.empty(); }
+  // index of alternative held by element pos
+  size_t index(size_t pos) const { return tags_[pos]; }
+
+  template<typename T>
+  requires(variant_traits::is_type_in_pack_v<std::remove_cvref_t<T>, Types...>)
+  void push_back(T&& val);
+  void push_back(const Variant<Types...>& val);
+
+  template<size_t I, typename... Args>
+  auto emplace_back(Args&&... args) -> variant_traits::get_type_by_index_t<I, Types...>&;
+  template<typename T, typename... Args>
+  auto emplace_back(Args&&... args) -> T&;
+
+  template<typename T>
+  bool holds_alternative(size_t pos) const;
+
+  template<size_t I>
+  auto get(size_t pos) -> variant_traits::get_type_by_index_t<I, Types...>&;
+  template<size_t I>
+  auto get(size_t pos) const -> const variant_traits::get_type_by_index_t<I, Types...>&;
+  template<typename T>
+  auto get(size_t pos) -> T&;
+  template<typename T>
+  auto get(size_t pos) const -> const T&;
+
+  // dense array of all elements holding alternative I, in insertion order
+  template<size_t I>
+  auto column() const -> const std::vector<variant_traits::get_type_by_index_t<I, Types...>>&;
+  template<typename T>
+  auto column() const -> const std::vector<T>&;
+
+  // calls visitor for every element grouped by alternative, not in insertion order
+  template<typename Visitor>
+  void visit_all(Visitor&& visitor);
+  template<typename Visitor>
+  void visit_all(Visitor&& visitor) const;
+
+  // reserves tag stream and rank index, split between columns is unknown in advance
+  void reserve(size_t n);
+  void clear();
+private:
+  static constexpr size_t kRankBlock = 64;
+
+  template<size_t I>
+  void CheckIndex(size_t pos) const;
+  template<size_t I>
+  size_t ColumnOffset(size_t pos) const;
+  std::array<uint32_t, sizeof...(Types)> ColumnSizes() const;
+
+  template<typename Visitor, typename Columns, size_t... Is>
+  static void VisitColumns(Visitor& visitor, Columns& columns, std::index_sequence<Is...>);
+
+  std::tuple<std::vector<Types>...> columns_;
+  std::vector<IndexType> tags_;
+  // column sizes before first element of every kRankBlock-sized block of tags_
+  std::vector<std::array<uint32_t, sizeof...(Types)>> block_ranks_;
+};
+
+template<typename... Types>
+template<size_t I, typename... Args>
+auto VariantVector<Types...>::emplace_back(Args&&... args) -> variant_traits::get_type_by_index_t<I, Types...>& {
+  auto& column = std::get<I>(columns_);
+  if (column.size() >= UINT32_MAX) {
+    throw std::length_error("VariantVector column is too long");
+  }
+  size_t old_size = tags_.size();
+  size_t old_blocks = block_ranks_.size();
+  try {
+    if (old_size % kRankBlock == 0) {
+      block_ranks_.push_back(ColumnSizes());
+    }
+    tags_.push_back(static_cast<IndexType>(I));
+    column.emplace_back(std::forward<Args>(args)...);
+  } catch (...) {
+    tags_.resize(old_size);
+    block_ranks_.resize(old_blocks);
+    throw;
+  }
+  return column.back();
+}
+
+template<typename... Types>
+template<typename T, typename... Args>
+auto VariantVector<Types...>::emplace_back(Args&&... args) -> T& {
+  return emplace_back<variant_traits::get_index_by_type_v<T, Types...>>(std::forward<Args>(args)...);
+}
+
+template<typename... Types>
+template<typename T>
+requires(variant_traits::is_type_in_pack_v<std::remove_cvref_t<T>, Types...>)
+void VariantVector<Types...>::push_back(T&& val) {
+  emplace_back<std::remove_cvref_t<T>>(std::forward<T>(val));
+}
+
+template<typename... Types>
+void VariantVector<Types...>::push_back(const Variant<Types...>& val) {
+  variant::visit([this](const auto& alternative) { push_back(alternative); }, val);
+}
+
+template<typename... Types>
+template<typename T>
+bool VariantVector<Types...>::holds_alternative(size_t pos) const {
+  return tags_[pos] == variant_traits::get_index_by_type_v<T, Types...>;
+}
+
+template<typename... Types>
+template<size_t I>
+void VariantVector<Types...>::CheckIndex(size_t pos) const {
+  if (tags_[pos] != I) {
+    throw std::runtime_error("Index is not active");
+  }
+}
+
+template<typename... Types>
+std::array<uint32_t, sizeof...(Types)> VariantVector<Types...>::ColumnSizes() const {
+  return std::apply([](const auto&... columns) {
+    return std::array<uint32_t, sizeof...(Types)>{static_cast<uint32_t>(columns.size())...};
+  }, columns_);
+}
+
+template<typename... Types>
+template<size_t I>
+size_t VariantVector<Types...>::ColumnOffset(size_t pos) const {
+  size_t block_start = pos - pos % kRankBlock;
+  size_t offset = block_ranks_[pos / kRankBlock][I];
+  for (size_t i = block_start; i < pos; ++i) {
+    offset += (tags_[i] == I);
+  }
+  return offset;
+}
+
+template<typename... Types>
+template<size_t I>
+auto VariantVector<Types...>::get(size_t pos) -> variant_traits::get_type_by_index_t<I, Types...>& {
+  CheckIndex<I>(pos);
+  return std::get<I>(columns_)[ColumnOffset<I>(pos)];
+}
+
+template<typename... Types>
+template<size_t I>
+auto VariantVector<Types...>::get(size_t pos) const -> const variant_traits::get_type_by_index_t<I, Types...>& {
+  CheckIndex<I>(pos);
+  return std::get<I>(columns_)[ColumnOffset<I>(pos)];
+}
+
+template<typename... Types>
+template<typename T>
+auto VariantVector<Types...>::get(size_t pos) -> T& {
+  return get<variant_traits::get_index_by_type_v<T, Types...>>(pos);
+}
+
+template<typename... Types>
+template<typename T>
+auto VariantVector<Types...>::get(size_t pos) const -> const T& {
+  return get<variant_traits::get_index_by_type_v<T, Types...>>(pos);
+}
+
+template<typename... Types>
+template<size_t I>
+auto VariantVector<Types...>::column() const -> const std::vector<variant_traits::get_type_by_index_t<I, Types...>>& {
+  return std::get<I>(columns_);
+}
+
+template<typename... Types>
+template<typename T>
+auto VariantVector<Types...>::column() const -> const std::vector<T>& {
+  return std::get<variant_traits::get_index_by_type_v<T, Types...>>(columns_);
+}
+
+template<typename... Types>
+template<typename Visitor, typename Columns, size_t... Is>
+void VariantVector<Types...>::VisitColumns(Visitor& visitor, Columns& columns, std::index_sequence<Is...>) {
+  // visitor is resolved once per column, loop body has no dispatch
+  auto visit_column = [&visitor](auto& column) {
+    for (auto& val : column) {
+      visitor(val);
+    }
+  };
+  (visit_column(std::get<Is>(columns)), ...);
+}
+
+template<typename... Types>
+template<typename Visitor>
+void VariantVector<Types...>::visit_all(Visitor&& visitor) {
+  VisitColumns(visitor, columns_, std::index_sequence_for<Types...>());
+}
+
+template<typename... Types>
+template<typename Visitor>
+void VariantVector<Types...>::visit_all(Visitor&& visitor) const {
+  VisitColumns(visitor, columns_, std::index_sequence_for<Types...>());
+}
+
+template<typename... Types>
+void VariantVector<Types...>::reserve(size_t n) {
+  tags_.reserve(n);
+  block_ranks_.reserve((n + kRankBlock - 1) / kRankBlock);
+}
+
+template<typename... Types>
+void VariantVector<Types...>::clear() {
+  std::apply([](auto&... columns) { (columns.clear(), ...); }, columns_);
+  tags_.clear();
+  block_ranks_.clear();
+}
+
+namespace variant {
+  template<typename T, typename... Types>
+  bool holds_alternative(const VariantVector<Types...>& v, size_t pos) {
+    return v.template holds_alternative<T>(pos);
+  }
+
+  template<typename T, typename... Types>
+  decltype(auto) get(VariantVector<Types...>& v, size_t pos) {
+    return v.template get<T>(pos);
+  }
+  template<typename T, typename... Types>
+  decltype(auto) get(const VariantVector<Types...>& v, size_t pos) {
+    return v.template get<T>(pos);
+  }
+  template<size_t Idx, typename... Types>
+  decltype(auto) get(VariantVector<Types...>& v, size_t pos) {
+    return v.template get<Idx>(pos);
+  }
+  template<size_t Idx, typename... Types>
+  decltype(auto) get(const VariantVector<Types...>& v, size_t pos) {
+    return v.template get<Idx>(pos);
+  }
+}
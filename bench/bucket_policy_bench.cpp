@@ -0,0 +1,51 @@
+// Per-lookup latency of UnorderedMap bucket policies. Every lookup key depends on the previous result,
+// so the time is latency of one find, not throughput of independent finds.
+// usage: bucket_policy_bench [lookups]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "../UnorderedMap.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Policy>
+using Map = UnorderedMap<size_t, size_t, std::hash<size_t>, std::equal_to<size_t>, std::allocator<std::pair<const size_t, size_t>>, Policy>;
+
+// keys are i * stride, values link all positions into one random cycle
+template<typename Policy>
+double LookupLatency(size_t count, size_t stride, size_t lookups, size_t& checksum) {
+  std::vector<size_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+  Map<Policy> map;
+  for (size_t i = 0; i < count; ++i) {
+    map.emplace(order[i] * stride, order[(i + 1) % count]);
+  }
+  size_t pos = order[0];
+  auto start = Clock::now();
+  for (size_t i = 0; i < lookups; ++i) {
+    pos = map.find(pos * stride)->second;
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  checksum += pos;
+  return elapsed.count() / lookups;
+}
+
+int main(int argc, char** argv) {
+  size_t lookups = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5'000'000;
+  size_t checksum = 0;
+  std::printf("%10s %8s %14s %14s\n", "elements", "stride", "pow2 ns", "prime ns");
+  for (size_t count : {1'000, 100'000, 1'000'000}) {
+    // stride 64 gives aligned keys that identity std::hash leaves with zero low bits
+    for (size_t stride : {1, 64}) {
+      double pow2 = LookupLatency<PowerOfTwoBucketPolicy>(count, stride, lookups, checksum);
+      double prime = LookupLatency<PrimeBucketPolicy>(count, stride, lookups, checksum);
+      std::printf("%10zu %8zu %14.2f %14.2f\n", count, stride, pow2, prime);
+    }
+  }
+  std::printf("checksum %zu\n", checksum);
+}
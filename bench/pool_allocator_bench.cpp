@@ -0,0 +1,66 @@
+// PoolAllocator against std::allocator on node churn: List push/pop and UnorderedMap insert/erase
+// with a sliding window of live elements, so freed nodes are reused by following allocations.
+// usage: pool_allocator_bench [operations]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include "../PoolAllocator.hpp"
+#include "../UnorderedMap.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+template<typename Alloc>
+using Map = UnorderedMap<size_t, size_t, std::hash<size_t>, std::equal_to<size_t>, Alloc>;
+
+// nanoseconds per push_back + pop_front pair
+template<typename Alloc>
+double ListChurn(size_t window, size_t ops, size_t& checksum) {
+  List<size_t, Alloc> list;
+  for (size_t i = 0; i < window; ++i) {
+    list.push_back(i);
+  }
+  auto start = Clock::now();
+  for (size_t i = 0; i < ops; ++i) {
+    list.push_back(i);
+    checksum += list.front();
+    list.pop_front();
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+// nanoseconds per insert + erase pair
+template<typename Alloc>
+double MapChurn(size_t window, size_t ops, size_t& checksum) {
+  Map<Alloc> map;
+  for (size_t i = 0; i < window; ++i) {
+    map.emplace(i, i);
+  }
+  auto start = Clock::now();
+  for (size_t i = 0; i < ops; ++i) {
+    map.emplace(window + i, i);
+    checksum += map.erase(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+int main(int argc, char** argv) {
+  size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2'000'000;
+  using StdAlloc = std::allocator<size_t>;
+  using PoolAlloc = PoolAllocator<size_t>;
+  using StdMapAlloc = std::allocator<std::pair<const size_t, size_t>>;
+  using PoolMapAlloc = PoolAllocator<std::pair<const size_t, size_t>>;
+  size_t checksum = 0;
+  std::printf("%8s %14s %14s %14s %14s\n", "window", "list std ns", "list pool ns", "map std ns", "map pool ns");
+  for (size_t window : {16, 1024, 65536}) {
+    double list_std = ListChurn<StdAlloc>(window, ops, checksum);
+    double list_pool = ListChurn<PoolAlloc>(window, ops, checksum);
+    double map_std = MapChurn<StdMapAlloc>(window, ops, checksum);
+    double map_pool = MapChurn<PoolMapAlloc>(window, ops, checksum);
+    std::printf("%8zu %14.2f %14.2f %14.2f %14.2f\n", window, list_std, list_pool, map_std, map_pool);
+  }
+  std::printf("checksum %zu\n", checksum);
+}
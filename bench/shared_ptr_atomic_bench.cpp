@@ -0,0 +1,103 @@
+// Multi-threaded copy/destroy stress of SharedPtr with AtomicPolicy.
+// Contention: every thread copies and destroys pointers to one object, compared with std::shared_ptr
+// and with SingleThreadPolicy in one thread. Last owner race: all threads drop copies of a fresh object
+// at once, object must be destroyed exactly once per round.
+// usage: shared_ptr_atomic_bench [copies per thread]
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../SharedPtr.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Counted {
+  static inline std::atomic<size_t> destroyed = 0;
+  explicit Counted(size_t payload): payload(payload) {}
+  ~Counted() { destroyed.fetch_add(1, std::memory_order_relaxed); }
+  size_t payload;
+};
+
+// wall nanoseconds per copy + destroy in each thread, all threads run at once
+template<typename Ptr>
+double CopyDestroy(const Ptr& source, size_t threads, size_t copies) {
+  std::atomic<bool> go = false;
+  std::atomic<size_t> checksum = 0;
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      size_t sum = 0;
+      for (size_t i = 0; i < copies; ++i) {
+        Ptr copy = source;
+        sum += copy->payload;
+      }
+      checksum.fetch_add(sum, std::memory_order_relaxed);
+    });
+  }
+  auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  assert(checksum.load() == threads * copies);
+  return elapsed.count() / copies;
+}
+
+// every round each thread gets own copy of new object and drops it after all threads got theirs
+void LastOwnerRace(size_t threads, size_t rounds) {
+  size_t destroyed_before = Counted::destroyed.load();
+  for (size_t round = 0; round < rounds; ++round) {
+    std::vector<SharedPtr<Counted, AtomicPolicy>> copies(threads, SharedPtr<Counted, AtomicPolicy>(1));
+    std::atomic<size_t> ready = 0;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        SharedPtr<Counted, AtomicPolicy> own = std::move(copies[t]);
+        ready.fetch_add(1, std::memory_order_acq_rel);
+        while (ready.load(std::memory_order_acquire) != threads) {
+          std::this_thread::yield();
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+  size_t destroyed = Counted::destroyed.load() - destroyed_before;
+  if (destroyed != rounds) {
+    std::printf("last owner race: %zu objects destroyed, expected %zu\n", destroyed, rounds);
+    std::abort();
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t copies = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+  size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  std::vector<size_t> thread_counts;
+  for (size_t threads = 1; threads < cores; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(cores);
+
+  SharedPtr<Counted, SingleThreadPolicy> single(1);
+  SharedPtr<Counted, AtomicPolicy> atomic(1);
+  auto standard = std::make_shared<Counted>(1);
+  std::printf("single thread policy, 1 thread: %.2f ns\n", CopyDestroy(single, 1, copies));
+  std::printf("%8s %14s %14s\n", "threads", "atomic ns", "std ns");
+  for (size_t threads : thread_counts) {
+    std::printf("%8zu %14.2f %14.2f\n", threads, CopyDestroy(atomic, threads, copies), CopyDestroy(standard, threads, copies));
+  }
+
+  size_t rounds = std::max<size_t>(copies / 10'000, 1);
+  LastOwnerRace(std::max<size_t>(cores, 2), rounds);
+  std::printf("last owner race: %zu rounds OK\n", rounds);
+}
@@ -0,0 +1,125 @@
+// ThreadPool against a single mutex + queue pool: throughput of tiny posted tasks and post-to-run latency.
+// usage: thread_pool_bench [tasks]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "../ThreadPool.hpp"
+
+// baseline: one lock and one condition variable shared by all workers
+class MutexQueuePool {
+public:
+  explicit MutexQueuePool(size_t threads) {
+    for (size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this] { Run(); });
+    }
+  }
+
+  ~MutexQueuePool() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  template<typename F>
+  void post(F&& func) {
+    {
+      std::lock_guard lock(mutex_);
+      tasks_.emplace(std::forward<F>(func));
+    }
+    cv_.notify_one();
+  }
+private:
+  void Run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::queue<std::function<void()>> tasks_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// millions of tasks per second, all posted from one outside thread
+template<typename Pool>
+double Throughput(size_t threads, size_t tasks) {
+  std::atomic<size_t> done = 0;
+  Pool pool(threads);
+  auto start = Clock::now();
+  for (size_t i = 0; i < tasks; ++i) {
+    pool.post([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+  }
+  while (done.load(std::memory_order_acquire) != tasks) {
+    std::this_thread::yield();
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  return tasks / elapsed.count() / 1e6;
+}
+
+// median microseconds between post and start of task, one task in flight
+template<typename Pool>
+double Latency(size_t threads, size_t rounds) {
+  Pool pool(threads);
+  std::vector<double> samples;
+  samples.reserve(rounds);
+  for (size_t i = 0; i < rounds; ++i) {
+    std::atomic<bool> started = false;
+    Clock::time_point run_at;
+    auto post_at = Clock::now();
+    pool.post([&] {
+      run_at = Clock::now();
+      started.store(true, std::memory_order_release);
+    });
+    while (!started.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    samples.push_back(std::chrono::duration<double, std::micro>(run_at - post_at).count());
+  }
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+  return samples[samples.size() / 2];
+}
+
+int main(int argc, char** argv) {
+  size_t tasks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+  size_t rounds = std::max<size_t>(tasks / 100, 1);
+  size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  std::printf("%8s %16s %16s %16s %16s\n", "threads", "pool Mtask/s", "mutex Mtask/s", "pool p50 us", "mutex p50 us");
+  // 1, 2, 4, ... and all cores
+  std::vector<size_t> thread_counts;
+  for (size_t threads = 1; threads < cores; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(cores);
+  for (size_t threads : thread_counts) {
+    std::printf("%8zu %16.2f %16.2f %16.2f %16.2f\n", threads,
+                Throughput<ThreadPool>(threads, tasks), Throughput<MutexQueuePool>(threads, tasks),
+                Latency<ThreadPool>(threads, rounds), Latency<MutexQueuePool>(threads, rounds));
+  }
+}
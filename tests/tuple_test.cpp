@@ -0,0 +1,27 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+#include "../Tuple.hpp"
+
+// element-wise copy is not needed for tuples of trivially copyable types without references
+static_assert(std::is_trivially_copyable_v<tuple<int, double>>);
+static_assert(!std::is_trivially_copyable_v<tuple<int&, double>>);
+static_assert(requires(int& first, std::pair<int, int>& second) { tie(first, second) = tuple<int, std::pair<int, int>>(); });
+
+// tie assigns through references, assignment of value tuples stays plain copy
+void TestTieAssign() {
+  int number = 0;
+  std::string text;
+  tie(number, text) = tuple<int, std::string>(5, "five");
+  assert(number == 5 && text == "five");
+
+  tuple<int, double> source(1, 2.5);
+  tuple<int, double> target(0, 0);
+  target = source;
+  assert(get<0>(target) == 1 && get<1>(target) == 2.5);
+}
+
+int main() {
+  TestTieAssign();
+  std::cout << "tuple_test: OK\n";
+}
@@ -0,0 +1,80 @@
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "../UnorderedMap.hpp"
+
+// copy assignment into non-empty map must free old nodes and keep list links in both directions
+void TestCopyAssignIntoNonEmpty() {
+  UnorderedMap<int, std::string> map;
+  for (int i = 0; i < 1000; ++i) {
+    map[i] = std::to_string(i);
+  }
+  UnorderedMap<int, std::string> copy(map);
+  copy[5000] = "extra";
+  map = copy;
+  assert(map.size() == 1001);
+  assert(map.at(5000) == "extra");
+  for (int i = 0; i < 1000; ++i) {
+    assert(map.at(i) == std::to_string(i));
+  }
+
+  UnorderedMap<int, std::string> small;
+  small[1] = "one";
+  small = map;
+  assert(small.size() == 1001);
+  small.erase(5000);
+  assert(small.size() == 1000 && !small.contains(5000));
+
+  map = UnorderedMap<int, std::string>();
+  assert(map.size() == 0);
+}
+
+void TestListCopyAssign() {
+  List<int> first;
+  List<int> second;
+  for (int i = 0; i < 10; ++i) {
+    first.push_back(i);
+    second.push_back(-i);
+  }
+  second = first;
+  int expected = 9;
+  for (auto it = second.end(); it != second.begin();) {
+    --it;
+    assert(*it == expected--);
+  }
+  second.pop_back();
+  assert(second.size() == 9);
+}
+
+struct ThrowingHash {
+  static inline bool armed = false;
+  std::size_t operator()(const std::string& key) const {
+    if (armed) {
+      throw std::runtime_error("hash");
+    }
+    return std::hash<std::string>()(key);
+  }
+};
+
+// key not extractable from (const char*, int), node is built first and must be freed when hasher throws
+void TestEmplaceHasherThrows() {
+  UnorderedMap<std::string, int, ThrowingHash> map;
+  map.emplace("a", 1);
+  ThrowingHash::armed = true;
+  bool thrown = false;
+  try {
+    map.emplace("a long key that does not fit into small string buffer", 2);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  ThrowingHash::armed = false;
+  assert(thrown && map.size() == 1);
+}
+
+int main() {
+  TestCopyAssignIntoNonEmpty();
+  TestListCopyAssign();
+  TestEmplaceHasherThrows();
+  std::cout << "unordered_map_test: OK\n";
+}
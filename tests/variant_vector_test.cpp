@@ -0,0 +1,64 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+#include "../VariantVector.hpp"
+
+struct Thrower {
+  explicit Thrower(bool fail) {
+    if (fail) {
+      throw std::runtime_error("construct");
+    }
+  }
+};
+
+// positions across many rank blocks must resolve to the same element as a plain vector of variants
+void TestGetAcrossBlocks() {
+  VariantVector<int, double, std::string> vv;
+  std::vector<Variant<int, double, std::string>> expected;
+  unsigned state = 1;
+  for (int i = 0; i < 1000; ++i) {
+    state = state * 1103515245 + 12345;
+    switch ((state >> 16) % 3) {
+      case 0: expected.emplace_back(i); break;
+      case 1: expected.emplace_back(i + 0.5); break;
+      default: expected.emplace_back(std::to_string(i)); break;
+    }
+    vv.push_back(expected.back());
+  }
+  assert(vv.size() == expected.size());
+  for (size_t pos = 0; pos < vv.size(); ++pos) {
+    assert(vv.index(pos) == expected[pos].index());
+    switch (vv.index(pos)) {
+      case 0: assert(vv.get<int>(pos) == variant::get<int>(expected[pos])); break;
+      case 1: assert(vv.get<1>(pos) == variant::get<1>(expected[pos])); break;
+      default: assert(variant::get<std::string>(vv, pos) == variant::get<std::string>(expected[pos])); break;
+    }
+  }
+}
+
+// failed emplace_back at block start must drop the rank entry it added
+void TestRollbackAtBlockStart() {
+  VariantVector<int, Thrower> vv;
+  for (int i = 0; i < 64; ++i) {
+    vv.push_back(i);
+  }
+  bool thrown = false;
+  try {
+    vv.emplace_back<Thrower>(true);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown && vv.size() == 64);
+  vv.emplace_back<Thrower>(false);
+  vv.push_back(64);
+  assert(vv.holds_alternative<Thrower>(64) && vv.get<int>(65) == 64 && vv.get<int>(63) == 63);
+  vv.clear();
+  vv.push_back(7);
+  assert(vv.get<int>(0) == 7);
+}
+
+int main() {
+  TestGetAcrossBlocks();
+  TestRollbackAtBlockStart();
+  std::cout << "variant_vector_test: OK\n";
+}